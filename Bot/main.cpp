@@ -7,9 +7,39 @@
 #include <d3c.h>
 #include <tchar.h>
 
+void D3C_API count_actors(d3c_module_context_t context, void *user)
+{
+	d3c_query_t query;
+
+	auto error = d3c_query_create(d3c_module_snapshot(context), D3C_QUERY_ACTORS, &query);
+
+	if(error)
+	{
+		std::cerr << "Error: " << error->message << std::endl;
+		d3c_free_error(error);
+		return;
+	}
+
+	size_t actors = 0;
+	size_t worlds = 0;
+
+	d3c_query_values(query, "id", 0, 0, &actors);
+	d3c_query_group(query, "world_id", 0, 0, 0, &worlds);
+
+	d3c_query_free(query);
+
+	std::cout << "Tick, " << actors << " actors in " << worlds << " worlds" << std::endl;
+}
+
 void D3C_API tick()
 {
-	std::cout << "Tick" << std::endl;
+	auto error = d3c_run_modules();
+
+	if(error)
+	{
+		std::cerr << "Error: " << error->message << std::endl;
+		d3c_free_error(error);
+	}
 }
 
 int _tmain(int argc, _TCHAR* argv[])
@@ -24,6 +54,14 @@ int _tmain(int argc, _TCHAR* argv[])
 		return 1;
 	}
 
+	error = d3c_module_register("actors", D3C_DATA_SNAPSHOT, 0, 0, &count_actors, 0);
+
+	if(error)
+	{
+		std::cerr << "Error: " << error->message << std::endl;
+		return 1;
+	}
+
 	error = d3c_loop(&tick);
 	
 	if(error)
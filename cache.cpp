@@ -0,0 +1,292 @@
+#include "cache.hpp"
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace Shade;
+
+struct CacheEntry
+{
+	size_t page;
+	size_t epoch;
+	bool is_static;
+	size_t prev; // Towards the most recently used entry
+	size_t next; // Towards the least recently used entry
+};
+
+struct CacheRange
+{
+	size_t start;
+	size_t end;
+	ReadCache::Policy policy;
+};
+
+static const size_t none = (size_t)-1;
+
+static bool enabled = false;
+static CRITICAL_SECTION lock;
+
+static std::vector<CacheEntry> entries;
+static std::vector<char> data;
+static std::unordered_map<size_t, size_t> lookup; // Page number to entry index
+static std::vector<CacheRange> ranges;
+
+static size_t epoch = 0;
+static size_t most_recent = none;
+static size_t least_recent = none;
+
+static uint64_t hits = 0;
+static uint64_t misses = 0;
+static uint64_t bytes_requested = 0;
+static uint64_t bytes_transferred = 0;
+static uint64_t bytes_saved = 0; // Bytes served from pages which were already cached
+static uint64_t bypassed = 0;
+
+static void unlink(size_t index)
+{
+	CacheEntry &entry = entries[index];
+
+	if(entry.prev != none)
+		entries[entry.prev].next = entry.next;
+	else
+		most_recent = entry.next;
+
+	if(entry.next != none)
+		entries[entry.next].prev = entry.prev;
+	else
+		least_recent = entry.prev;
+}
+
+static void link_front(size_t index)
+{
+	CacheEntry &entry = entries[index];
+
+	entry.prev = none;
+	entry.next = most_recent;
+
+	if(most_recent != none)
+		entries[most_recent].prev = index;
+	else
+		least_recent = index;
+
+	most_recent = index;
+}
+
+static void link_back(size_t index)
+{
+	CacheEntry &entry = entries[index];
+
+	entry.prev = least_recent;
+	entry.next = none;
+
+	if(least_recent != none)
+		entries[least_recent].next = index;
+	else
+		most_recent = index;
+
+	least_recent = index;
+}
+
+static ReadCache::Policy policy(size_t page)
+{
+	size_t address = page * ReadCache::page_size;
+
+	for(auto range = ranges.rbegin(); range != ranges.rend(); ++range)
+		if(address >= range->start && address < range->end)
+			return range->policy;
+
+	return ReadCache::Frame;
+}
+
+// Returns the cached data for a page, reading it from the process if needed. Returns 0 if the page can't be read.
+static const char *get_page(size_t page, bool is_static)
+{
+	auto result = lookup.find(page);
+
+	if(result != lookup.end())
+	{
+		size_t index = result->second;
+		CacheEntry &entry = entries[index];
+
+		if(entry.is_static || entry.epoch == epoch)
+		{
+			hits++;
+
+			unlink(index);
+			link_front(index);
+
+			return &data[index * ReadCache::page_size];
+		}
+	}
+
+	misses++;
+
+	size_t index;
+
+	if(result != lookup.end())
+	{
+		index = result->second;
+	}
+	else
+	{
+		index = least_recent;
+
+		if(entries[index].page != none)
+			lookup.erase(entries[index].page);
+
+		entries[index].page = page;
+		lookup[page] = index;
+	}
+
+	char *buffer = &data[index * ReadCache::page_size];
+
+	unlink(index);
+
+	if(!ReadProcessMemory(process, (void *)(page * ReadCache::page_size), buffer, ReadCache::page_size, 0))
+	{
+		lookup.erase(page);
+		entries[index].page = none;
+		link_back(index);
+
+		return 0;
+	}
+
+	bytes_transferred += ReadCache::page_size;
+
+	entries[index].epoch = epoch;
+	entries[index].is_static = is_static;
+
+	link_front(index);
+
+	return buffer;
+}
+
+void ReadCache::enable(size_t pages)
+{
+	InitializeCriticalSection(&lock);
+
+	entries.resize(pages);
+	data.resize(pages * page_size);
+
+	for(size_t i = 0; i < pages; ++i)
+	{
+		entries[i].page = none;
+		link_back(i);
+	}
+
+	enabled = true;
+}
+
+void ReadCache::set_policy(const void *start, size_t size, Policy policy)
+{
+	CacheRange range = {(size_t)start, (size_t)start + size, policy};
+
+	ranges.push_back(range);
+}
+
+void ReadCache::next_epoch()
+{
+	if(!enabled)
+		return;
+
+	EnterCriticalSection(&lock);
+	epoch++;
+	LeaveCriticalSection(&lock);
+}
+
+void ReadCache::invalidate(const void *remote, size_t size)
+{
+	if(!enabled || !size)
+		return;
+
+	EnterCriticalSection(&lock);
+
+	size_t first = (size_t)remote / page_size;
+	size_t last = ((size_t)remote + size - 1) / page_size;
+
+	for(size_t page = first; page <= last; ++page)
+	{
+		auto result = lookup.find(page);
+
+		if(result == lookup.end())
+			continue;
+
+		size_t index = result->second;
+
+		lookup.erase(result);
+		entries[index].page = none;
+
+		unlink(index);
+		link_back(index);
+	}
+
+	LeaveCriticalSection(&lock);
+}
+
+bool ReadCache::read(const void *remote, void *local, size_t size)
+{
+	if(!enabled || !size)
+		return false;
+
+	size_t first = (size_t)remote / page_size;
+	size_t last = ((size_t)remote + size - 1) / page_size;
+
+	// Reads larger than the cache are done directly
+	if(last - first >= entries.size())
+		return false;
+
+	EnterCriticalSection(&lock);
+
+	bool result = true;
+	size_t offset = (size_t)remote % page_size;
+	char *output = (char *)local;
+
+	for(size_t page = first; page <= last; ++page)
+	{
+		Policy page_policy = policy(page);
+		uint64_t previous_misses = misses;
+
+		const char *buffer = page_policy == Uncached ? 0 : get_page(page, page_policy == Static);
+
+		if(!buffer)
+		{
+			result = false;
+			break;
+		}
+
+		size_t length = std::min(page_size - offset, size - (output - (char *)local));
+
+		memcpy(output, buffer + offset, length);
+
+		if(misses == previous_misses)
+			bytes_saved += length;
+
+		output += length;
+		offset = 0;
+	}
+
+	if(result)
+		bytes_requested += size;
+	else
+		bypassed++;
+
+	LeaveCriticalSection(&lock);
+
+	return result;
+}
+
+void ReadCache::report()
+{
+	if(!enabled)
+		return;
+
+	EnterCriticalSection(&lock);
+
+	uint64_t lookups = hits + misses;
+
+	printf("Read cache: %.1f%% hit rate (%llu hits, %llu misses, %llu bypassed), %.1f KB requested, %.1f KB transferred, %.1f KB saved\n",
+		lookups ? hits * 100.0 / lookups : 0.0, hits, misses, bypassed,
+		bytes_requested / 1024.0, bytes_transferred / 1024.0, bytes_saved / 1024.0);
+
+	LeaveCriticalSection(&lock);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "shade.hpp"
+
+namespace Shade
+{
+	/*
+		Page granular read-through cache used by Shade::read.
+		Host side walks of game structures read many small fields from the same pages, so each page is
+		transferred once and later reads are served from the cache. Entries are evicted in LRU order.
+		Writes done through Shade::write and write_batch invalidate the pages they touch.
+	*/
+	namespace ReadCache
+	{
+		enum Policy
+		{
+			Uncached, // Always read from the process
+			Frame, // Valid until the epoch changes, used for data the game modifies (the default)
+			Static // Valid until evicted or written to, used for read-only sections of modules
+		};
+
+		static const size_t page_size = 0x1000;
+
+		// Enables the cache with room for 'pages' pages. The cache is disabled until this is called.
+		void enable(size_t pages);
+
+		// Sets the policy for a range of addresses. Ranges added later take precedence.
+		void set_policy(const void *start, size_t size, Policy policy);
+
+		// Invalidates all Frame pages. Called once for each tick of the remote process.
+		void next_epoch();
+
+		void invalidate(const void *remote, size_t size);
+
+		// Returns false if the range isn't cacheable and must be read directly
+		bool read(const void *remote, void *local, size_t size);
+
+		void report();
+	};
+};
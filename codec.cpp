@@ -0,0 +1,615 @@
+#include "codec.hpp"
+#include "recorder.hpp"
+#include <map>
+
+using namespace Shade;
+
+static const uint32_t file_magic = 0x43434853; // "SHCC"
+static const uint32_t file_version = 2;
+
+namespace Format
+{
+	// These match the COMPRESSION_FORMAT_* values used by ntdll
+	enum Type
+	{
+		None = 0,
+		LZNT1 = 2,
+		XPRESS = 3
+	};
+};
+
+namespace Column
+{
+	enum Type
+	{
+		Time,
+		ActorCount,
+		ActorPtr,
+		ActorName,
+		ActorId,
+		ActorAcdId,
+		ActorWorldId,
+		AcdCount,
+		AcdPtr,
+		AcdName,
+		AcdId,
+		AcdOwnerId,
+		Dictionary,
+		Count
+	};
+};
+
+struct BlockHeader
+{
+	uint32_t raw_size;
+	uint32_t stored_size;
+	uint32_t format;
+};
+
+struct Footer
+{
+	uint64_t index_offset;
+	uint32_t blocks;
+	uint32_t magic;
+};
+
+struct Output
+{
+	std::vector<uint8_t> bytes;
+
+	void put_varint(uint64_t value)
+	{
+		while(value >= 0x80)
+		{
+			bytes.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+
+		bytes.push_back((uint8_t)value);
+	}
+
+	// Zigzag encoding keeps small negative values small
+	void put_signed(int64_t value)
+	{
+		put_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	}
+
+	void put_bytes(const void *data, size_t size)
+	{
+		bytes.insert(bytes.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+	}
+};
+
+struct Input
+{
+	const uint8_t *current;
+	const uint8_t *end;
+
+	Input(const uint8_t *start, size_t size) : current(start), end(start + size) {}
+
+	uint64_t get_varint()
+	{
+		uint64_t result = 0;
+
+		for(size_t shift = 0;; shift += 7)
+		{
+			if(current == end || shift > 63)
+				error("Corrupt column data");
+
+			uint8_t byte = *current++;
+
+			result |= (uint64_t)(byte & 0x7F) << shift;
+
+			if(!(byte & 0x80))
+				return result;
+		}
+	}
+
+	int64_t get_signed()
+	{
+		uint64_t value = get_varint();
+
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	const uint8_t *get_bytes(size_t size)
+	{
+		if((size_t)(end - current) < size)
+			error("Corrupt column data");
+
+		const uint8_t *result = current;
+
+		current += size;
+
+		return result;
+	}
+};
+
+struct Delta
+{
+	int64_t previous;
+
+	Delta() : previous(0) {}
+
+	void put(Output &out, int64_t value)
+	{
+		out.put_signed(value - previous);
+		previous = value;
+	}
+
+	int64_t get(Input &in)
+	{
+		previous += in.get_signed();
+		return previous;
+	}
+};
+
+struct DeltaOfDelta
+{
+	int64_t previous;
+	int64_t previous_delta;
+
+	DeltaOfDelta() : previous(0), previous_delta(0) {}
+
+	void put(Output &out, int64_t value)
+	{
+		int64_t delta = value - previous;
+
+		out.put_signed(delta - previous_delta);
+
+		previous = value;
+		previous_delta = delta;
+	}
+
+	int64_t get(Input &in)
+	{
+		previous_delta += in.get_signed();
+		previous += previous_delta;
+		return previous;
+	}
+};
+
+typedef LONG (WINAPI *RtlGetCompressionWorkSpaceSizeFunc)(unsigned short format, unsigned long *buffer_size, unsigned long *fragment_size);
+typedef LONG (WINAPI *RtlCompressBufferFunc)(unsigned short format, unsigned char *input, unsigned long input_size, unsigned char *output, unsigned long output_size, unsigned long chunk_size, unsigned long *final_size, void *workspace);
+typedef LONG (WINAPI *RtlDecompressBufferFunc)(unsigned short format, unsigned char *output, unsigned long output_size, unsigned char *input, unsigned long input_size, unsigned long *final_size);
+
+static RtlCompressBufferFunc rtl_compress;
+static RtlDecompressBufferFunc rtl_decompress;
+static Format::Type compress_format = Format::None;
+static std::vector<char> workspace;
+
+// XPRESS is only supported by Windows 8 and later, so LZNT1 is used when it isn't available
+static void load_compressor()
+{
+	if(rtl_compress)
+		return;
+
+	HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+
+	auto workspace_size = (RtlGetCompressionWorkSpaceSizeFunc)GetProcAddress(ntdll, "RtlGetCompressionWorkSpaceSize");
+	rtl_compress = (RtlCompressBufferFunc)GetProcAddress(ntdll, "RtlCompressBuffer");
+	rtl_decompress = (RtlDecompressBufferFunc)GetProcAddress(ntdll, "RtlDecompressBuffer");
+
+	if(!workspace_size || !rtl_compress || !rtl_decompress)
+		error("Unable to find the compression routines in ntdll");
+
+	Format::Type formats[] = {Format::XPRESS, Format::LZNT1};
+
+	for(size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+	{
+		unsigned long buffer_size, fragment_size;
+
+		if(workspace_size((unsigned short)formats[i], &buffer_size, &fragment_size) == 0)
+		{
+			compress_format = formats[i];
+			workspace.resize(buffer_size);
+			return;
+		}
+	}
+}
+
+static void encode_block(const std::vector<Codec::Frame> &frames, Output &raw)
+{
+	Output columns[Column::Count];
+
+	DeltaOfDelta time;
+	Delta actor_count, actor_ptr, acd_count, acd_ptr;
+	DeltaOfDelta actor_id, actor_acd_id, actor_world_id, acd_id, acd_owner_id;
+
+	std::map<std::string, size_t> names;
+	std::vector<const std::string *> dictionary;
+
+	auto name_index = [&](const std::string &name) -> size_t {
+		auto result = names.insert(std::make_pair(name, dictionary.size()));
+
+		if(result.second)
+			dictionary.push_back(&result.first->first);
+
+		return result.first->second;
+	};
+
+	for(auto frame = frames.begin(); frame != frames.end(); ++frame)
+	{
+		time.put(columns[Column::Time], frame->time);
+		actor_count.put(columns[Column::ActorCount], frame->actors.size());
+		acd_count.put(columns[Column::AcdCount], frame->acds.size());
+
+		for(auto actor = frame->actors.begin(); actor != frame->actors.end(); ++actor)
+		{
+			actor_ptr.put(columns[Column::ActorPtr], (size_t)actor->ptr);
+			columns[Column::ActorName].put_varint(name_index(actor->name));
+			actor_id.put(columns[Column::ActorId], actor->id);
+			actor_acd_id.put(columns[Column::ActorAcdId], actor->acd_id);
+			actor_world_id.put(columns[Column::ActorWorldId], actor->world_id);
+		}
+
+		for(auto acd = frame->acds.begin(); acd != frame->acds.end(); ++acd)
+		{
+			acd_ptr.put(columns[Column::AcdPtr], (size_t)acd->ptr);
+			columns[Column::AcdName].put_varint(name_index(acd->name));
+			acd_id.put(columns[Column::AcdId], acd->id);
+			acd_owner_id.put(columns[Column::AcdOwnerId], acd->owner_id);
+		}
+	}
+
+	Output &names_column = columns[Column::Dictionary];
+
+	names_column.put_varint(dictionary.size());
+
+	for(auto name = dictionary.begin(); name != dictionary.end(); ++name)
+	{
+		names_column.put_varint((*name)->size());
+		names_column.put_bytes((*name)->data(), (*name)->size());
+	}
+
+	raw.put_varint(frames.size());
+
+	for(size_t i = 0; i < Column::Count; ++i)
+		raw.put_varint(columns[i].bytes.size());
+
+	for(size_t i = 0; i < Column::Count; ++i)
+		raw.put_bytes(columns[i].bytes.data(), columns[i].bytes.size());
+}
+
+static void decode_block(const uint8_t *data, size_t size, std::vector<Codec::Frame> &frames)
+{
+	Input raw(data, size);
+
+	size_t frame_count = (size_t)raw.get_varint();
+	size_t sizes[Column::Count];
+
+	for(size_t i = 0; i < Column::Count; ++i)
+		sizes[i] = (size_t)raw.get_varint();
+
+	std::vector<Input> columns;
+
+	for(size_t i = 0; i < Column::Count; ++i)
+		columns.push_back(Input(raw.get_bytes(sizes[i]), sizes[i]));
+
+	Input &names_column = columns[Column::Dictionary];
+
+	std::vector<std::string> dictionary((size_t)names_column.get_varint());
+
+	for(auto name = dictionary.begin(); name != dictionary.end(); ++name)
+	{
+		size_t length = (size_t)names_column.get_varint();
+
+		name->assign((const char *)names_column.get_bytes(length), length);
+	}
+
+	auto name = [&](Input &in) -> const std::string & {
+		size_t index = (size_t)in.get_varint();
+
+		if(index >= dictionary.size())
+			error("Corrupt column data");
+
+		return dictionary[index];
+	};
+
+	DeltaOfDelta time;
+	Delta actor_count, actor_ptr, acd_count, acd_ptr;
+	DeltaOfDelta actor_id, actor_acd_id, actor_world_id, acd_id, acd_owner_id;
+
+	frames.resize(frame_count);
+
+	for(auto frame = frames.begin(); frame != frames.end(); ++frame)
+	{
+		frame->time = time.get(columns[Column::Time]);
+		frame->actors.resize((size_t)actor_count.get(columns[Column::ActorCount]));
+		frame->acds.resize((size_t)acd_count.get(columns[Column::AcdCount]));
+
+		for(auto actor = frame->actors.begin(); actor != frame->actors.end(); ++actor)
+		{
+			actor->ptr = (void *)(size_t)actor_ptr.get(columns[Column::ActorPtr]);
+			actor->name = name(columns[Column::ActorName]);
+			actor->id = (size_t)actor_id.get(columns[Column::ActorId]);
+			actor->acd_id = (size_t)actor_acd_id.get(columns[Column::ActorAcdId]);
+			actor->world_id = (size_t)actor_world_id.get(columns[Column::ActorWorldId]);
+		}
+
+		for(auto acd = frame->acds.begin(); acd != frame->acds.end(); ++acd)
+		{
+			acd->ptr = (void *)(size_t)acd_ptr.get(columns[Column::AcdPtr]);
+			acd->name = name(columns[Column::AcdName]);
+			acd->id = (size_t)acd_id.get(columns[Column::AcdId]);
+			acd->owner_id = (size_t)acd_owner_id.get(columns[Column::AcdOwnerId]);
+		}
+	}
+}
+
+Codec::Writer::Writer(const std::string &filename) : filename(filename), frames(0), raw_bytes(0), stored_bytes(0)
+{
+	load_compressor();
+
+	file.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+
+	if(!file)
+		error("Unable to create " + filename);
+
+	file.write((const char *)&file_magic, sizeof(file_magic));
+	file.write((const char *)&file_version, sizeof(file_version));
+}
+
+void Codec::Writer::add(const Frame &frame)
+{
+	pending.push_back(frame);
+
+	if(pending.size() == block_frames)
+		flush();
+}
+
+void Codec::Writer::flush()
+{
+	if(pending.empty())
+		return;
+
+	Output raw;
+
+	encode_block(pending, raw);
+
+	BlockHeader header;
+
+	header.raw_size = raw.bytes.size();
+
+	// LZNT1 can expand incompressible data slightly
+	std::vector<uint8_t> stored(raw.bytes.size() + raw.bytes.size() / 8 + 0x100);
+	unsigned long stored_size;
+
+	if(rtl_compress((unsigned short)compress_format, raw.bytes.data(), raw.bytes.size(), stored.data(), stored.size(), 0x1000, &stored_size, workspace.data()) == 0 && stored_size < raw.bytes.size())
+	{
+		header.format = compress_format;
+		header.stored_size = stored_size;
+	}
+	else
+	{
+		header.format = Format::None;
+		header.stored_size = raw.bytes.size();
+		stored = raw.bytes;
+	}
+
+	Block block;
+
+	block.offset = (uint64_t)file.tellp();
+	block.first_time = pending.front().time;
+	block.first_frame = frames;
+	block.frames = pending.size();
+
+	blocks.push_back(block);
+
+	file.write((const char *)&header, sizeof(header));
+	file.write((const char *)stored.data(), header.stored_size);
+
+	if(!file)
+		error("Unable to write " + filename);
+
+	raw_bytes += header.raw_size;
+	stored_bytes += sizeof(header) + header.stored_size;
+	frames += pending.size();
+
+	pending.clear();
+}
+
+void Codec::Writer::close()
+{
+	flush();
+
+	Footer footer;
+
+	footer.index_offset = (uint64_t)file.tellp();
+	footer.blocks = blocks.size();
+	footer.magic = file_magic;
+
+	if(!blocks.empty())
+		file.write((const char *)&blocks[0], blocks.size() * sizeof(Block));
+
+	file.write((const char *)&footer, sizeof(footer));
+
+	if(!file)
+		error("Unable to write " + filename);
+
+	file.close();
+}
+
+Codec::Reader::Reader(const std::string &filename) : filename(filename)
+{
+	load_compressor();
+
+	file.open(filename.c_str(), std::ios::binary);
+
+	uint32_t magic, version;
+
+	if(file.read((char *)&magic, sizeof(magic)).fail() || file.read((char *)&version, sizeof(version)).fail())
+		error("Unable to read " + filename);
+
+	if(magic != file_magic || version != file_version)
+		error(filename + " is not a compressed recording");
+
+	Footer footer;
+
+	file.seekg(-(std::streamoff)sizeof(footer), std::ios::end);
+
+	if(file.read((char *)&footer, sizeof(footer)).fail() || footer.magic != file_magic)
+		error(filename + " is incomplete");
+
+	blocks.resize(footer.blocks);
+
+	file.seekg((std::streamoff)footer.index_offset);
+
+	if(!blocks.empty() && file.read((char *)&blocks[0], blocks.size() * sizeof(Block)).fail())
+		error(filename + " is incomplete");
+}
+
+size_t Codec::Reader::find(uint64_t time)
+{
+	size_t low = 0;
+	size_t high = blocks.size();
+
+	while(high - low > 1)
+	{
+		size_t middle = (low + high) / 2;
+
+		if(blocks[middle].first_time <= time)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+void Codec::Reader::read(size_t index, std::vector<Frame> &frames)
+{
+	BlockHeader header;
+
+	file.clear();
+	file.seekg((std::streamoff)blocks[index].offset);
+
+	if(file.read((char *)&header, sizeof(header)).fail())
+		error("Unable to read " + filename);
+
+	std::vector<uint8_t> stored(header.stored_size);
+
+	if(header.stored_size && file.read((char *)stored.data(), header.stored_size).fail())
+		error("Unable to read " + filename);
+
+	if(header.format == Format::None)
+	{
+		decode_block(stored.data(), stored.size(), frames);
+		return;
+	}
+
+	std::vector<uint8_t> raw(header.raw_size);
+	unsigned long raw_size;
+
+	if(rtl_decompress((unsigned short)header.format, raw.data(), raw.size(), stored.data(), stored.size(), &raw_size) != 0 || raw_size != header.raw_size)
+		error(filename + " is corrupt");
+
+	decode_block(raw.data(), raw.size(), frames);
+}
+
+void Codec::capture(Frame &frame, uint64_t time)
+{
+	frame.time = time;
+	frame.actors.clear();
+	frame.acds.clear();
+
+	auto name = [](Ptr<String> &string) -> std::string {
+		return string ? string->c_str() : "";
+	};
+
+	for(auto i = shared->data.actors->begin(); i != shared->data.actors->end(); ++i)
+	{
+		External::Actor actor;
+
+		actor.ptr = i().ptr;
+		actor.name = name(i().name);
+		actor.id = i().id;
+		actor.acd_id = i().acd_id;
+		actor.world_id = i().world_id;
+
+		frame.actors.push_back(actor);
+	}
+
+	for(auto i = shared->data.acds->begin(); i != shared->data.acds->end(); ++i)
+	{
+		External::ActorCommonData acd;
+
+		acd.ptr = i().ptr;
+		acd.name = name(i().name);
+		acd.id = i().id;
+		acd.owner_id = i().owner_id;
+
+		frame.acds.push_back(acd);
+	}
+}
+
+static double seconds_since(LARGE_INTEGER &start)
+{
+	LARGE_INTEGER now, frequency;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+
+	return (double)(now.QuadPart - start.QuadPart) / frequency.QuadPart;
+}
+
+void Codec::compress_recording(const std::string &path)
+{
+	std::string filename = path + ".columns";
+
+	LARGE_INTEGER start;
+	double encode_time = 0.0;
+	size_t frame_count = 0;
+	uint64_t snapshot_bytes = 0;
+
+	Writer writer(filename);
+	Frame frame;
+
+	// Only the encoding is timed, not loading the recording
+	Recorder::load(path, [&](uint64_t time) {
+		QueryPerformanceCounter(&start);
+
+		capture(frame, time);
+		writer.add(frame);
+
+		encode_time += seconds_since(start);
+		frame_count++;
+		snapshot_bytes += sizeof(shared->data) + shared->heap_used;
+	});
+
+	QueryPerformanceCounter(&start);
+	writer.close();
+	encode_time += seconds_since(start);
+
+	Reader reader(filename);
+	std::vector<Frame> frames;
+	size_t decoded = 0;
+
+	QueryPerformanceCounter(&start);
+
+	for(size_t i = 0; i < reader.blocks.size(); ++i)
+	{
+		reader.read(i, frames);
+		decoded += frames.size();
+	}
+
+	double decode_time = seconds_since(start);
+
+	if(decoded != frame_count)
+		error(filename + " doesn't contain every frame");
+
+	double raw_mb = writer.raw_bytes / (1024.0 * 1024.0);
+
+	printf("Compressed %u frames in %u blocks, %.1f KB of snapshots, %.1f KB of columns to %.1f KB (%.2fx) with %s\n", frame_count, reader.blocks.size(),
+		snapshot_bytes / 1024.0, writer.raw_bytes / 1024.0, writer.stored_bytes / 1024.0, writer.stored_bytes ? (double)snapshot_bytes / writer.stored_bytes : 0.0,
+		compress_format == Format::XPRESS ? "XPRESS" : "LZNT1");
+
+	printf("Encoding: %.1f MB/s, decoding: %.1f MB/s of columns\n", encode_time > 0.0 ? raw_mb / encode_time : 0.0, decode_time > 0.0 ? raw_mb / decode_time : 0.0);
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_compress_recording(const char *path)
+{
+	return Shade::wrap([&] {
+		Codec::compress_recording(path);
+	});
+}
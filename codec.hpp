@@ -0,0 +1,78 @@
+#pragma once
+#include "shade.hpp"
+#include "reader.hpp"
+#include <fstream>
+
+namespace Shade
+{
+	/*
+		Compact storage for the actors and ACDs of recorded snapshots.
+		Frames are grouped into blocks which are encoded one column at a time. Ids and times are stored as
+		delta-of-delta, addresses as deltas and names as indices into a dictionary for the block, all packed as varints.
+		Each block is then compressed with the compressor in ntdll. An index at the end of the file lists
+		the blocks, so any block can be decoded without decoding the ones before it.
+	*/
+	namespace Codec
+	{
+		static const size_t block_frames = 64;
+
+		struct Frame
+		{
+			uint64_t time;
+			std::vector<External::Actor> actors;
+			std::vector<External::ActorCommonData> acds;
+		};
+
+		struct Block
+		{
+			uint64_t offset;
+			uint64_t first_time;
+			uint32_t first_frame;
+			uint32_t frames;
+		};
+
+		class Writer
+		{
+			std::ofstream file;
+			std::string filename;
+			std::vector<Frame> pending;
+			std::vector<Block> blocks;
+			uint32_t frames;
+
+			void flush();
+
+		public:
+			uint64_t raw_bytes; // Size of the blocks before compression
+			uint64_t stored_bytes;
+
+			Writer(const std::string &filename);
+
+			void add(const Frame &frame);
+
+			// Writes the remaining frames and the index
+			void close();
+		};
+
+		class Reader
+		{
+			std::ifstream file;
+			std::string filename;
+
+		public:
+			std::vector<Block> blocks;
+
+			Reader(const std::string &filename);
+
+			// Returns the index of the block containing the frame at or before 'time'
+			size_t find(uint64_t time);
+
+			void read(size_t block, std::vector<Frame> &frames);
+		};
+
+		// Copies the actors and ACDs of the snapshot in the shared mapping
+		void capture(Frame &frame, uint64_t time);
+
+		// Encodes a raw recording to <path>.columns and prints the compression ratio and throughput
+		void compress_recording(const std::string &path);
+	};
+};
@@ -1,9 +1,12 @@
 #include "../shade.hpp"
 #include "../process.hpp"
+#include "../profile.hpp"
 #include "compiler.hpp"
 #include "disassembler.hpp"
 #include "emitter.hpp"
 #include "engine.hpp"
+#include "image.hpp"
+#include "stats.hpp"
 
 #include <sstream>
 
@@ -24,6 +27,7 @@
 #include <llvm/Support/Debug.h>
 #include <llvm/Bitcode/ReaderWriter.h>
 #include <llvm/PassManager.h>
+#include <llvm/Transforms/Scalar.h>
 #include <llvm/Target/TargetData.h>
 #include <llvm/Support/CommandLine.h>
 
@@ -45,7 +49,8 @@ static Function *create_ctor_func(Module *module, GlobalVariable *gv)
 {
 	Function *fn = module->getFunction("ctors");
 
-	assert(fn);
+	if(!fn)
+		Shade::error("The bitcode doesn't declare a ctors function");
 
 	BasicBlock *bb = BasicBlock::Create(getGlobalContext(), "entry", fn);
   
@@ -86,16 +91,117 @@ static Function *create_ctor_func(Module *module, GlobalVariable *gv)
 	return fn;
 }
 
-void Shade::compile_module()
+/*
+	Folds the layout_* globals referenced by remote code into constants from the layout profile.
+	Loads of the globals are replaced directly so code generation sees constant offsets and sizes.
+*/
+static void bake_layout(Module *module)
 {
-	srand(GetTickCount());
+	for(size_t i = 0; i < Shade::Layout::Count; ++i)
+	{
+		auto &entry = Shade::Layout::values[i];
 
-	install_fatal_error_handler(fatal_error_handler);
+		GlobalVariable *global = module->getNamedGlobal(entry.symbol);
 
-	Engine::modules.push_back("user32.dll");
-	Engine::modules.push_back("kernel32.dll");
-	Engine::modules.push_back("ntdll.dll");
+		if(!global)
+			continue;
+
+		Constant *value = ConstantInt::get(global->getType()->getElementType(), entry.value);
+
+		std::vector<LoadInst *> loads;
+
+		for(auto use = global->use_begin(); use != global->use_end(); ++use)
+		{
+			if(LoadInst *load = dyn_cast<LoadInst>(*use))
+				loads.push_back(load);
+		}
+
+		for(auto load = loads.begin(); load != loads.end(); ++load)
+		{
+			(*load)->replaceAllUsesWith(value);
+			(*load)->eraseFromParent();
+		}
+
+		// Any other uses will refer to a constant global holding the value
+		global->setInitializer(value);
+		global->setConstant(true);
+		global->setLinkage(GlobalValue::InternalLinkage);
+	}
+}
+
+/*
+	Runs code generation for a verified module and writes the result to the remote process in 'code' and 'data'.
+	'done' is called with the engine and emitter once relocations have been resolved.
+*/
+template<typename F> static void generate(Module *module, Shade::RemoteHeap &code, Shade::RemoteHeap &data, F done)
+{
+	EngineBuilder engine_builder(module);
+
+	engine_builder.setEngineKind(EngineKind::JIT);
+	engine_builder.setRelocationModel(Reloc::Static);
+	engine_builder.setCodeModel(CodeModel::Small);
+	engine_builder.setOptLevel(CodeGenOpt::Default);
+	
+	OwningPtr<TargetMachine> target(engine_builder.selectTarget());
+
+	FunctionPassManager pass_manager(module);
+
+	pass_manager.add(new TargetData(*target->getTargetData()));
+
+	// Fold the branches and address computations depending on the baked layout constants (see CopyRun)
+	pass_manager.add(createScalarReplAggregatesPass());
+	pass_manager.add(createInstructionCombiningPass());
+	pass_manager.add(createSCCPPass());
+	pass_manager.add(createCFGSimplificationPass());
+	
+	Shade::Engine engine(module, *target->getTargetData());
+	Shade::Emitter emitter(engine, *target, code, data);
+
+	if(target->addPassesToEmitMachineCode(pass_manager, emitter))
+	{
+		llvm::report_fatal_error("Target does not support machine code emission!");
+	}
 
+	auto &functions = module->getFunctionList();
+
+	for(auto i = functions.begin(); i != functions.end(); ++i)
+	{
+		size_t emitted = Shade::CompileStats::current.functions.size();
+		uint64_t start = Shade::CompileStats::ticks();
+
+		pass_manager.run(*i);
+
+		double time = Shade::CompileStats::add(Shade::CompileStats::Codegen, start);
+
+		if(Shade::CompileStats::current.functions.size() > emitted)
+			Shade::CompileStats::current.functions.back().codegen_ms = time;
+	}
+
+	emitter.resolveRelocations();
+
+	done(engine, emitter);
+}
+
+void *Shade::compile_function(Module *module, const std::string &name)
+{
+	verifyModule(*module);
+
+	void *result;
+
+	generate(module, Shade::code_section, data_section, [&](Shade::Engine &engine, Shade::Emitter &emitter) {
+		result = engine.getPointerToFunction(name);
+	});
+
+	return result;
+}
+
+/*
+	Runs code generation for the bitcode, writes the result to the remote process in 'code' and 'data' and
+	records it in 'image'. Returns the address of the init function.
+	Other bitcode may be compiled for benchmarks without 'entry_points', which makes ctors and init optional.
+*/
+static void *compile(MemoryBuffer *buffer, Shade::RemoteHeap &code, Shade::RemoteHeap &data, Shade::Image &image, bool &cacheable, bool entry_points = true)
+{
 	InitializeNativeTarget();
 
 	const char *argv[] = {"", "-debug-pass=Executions"};
@@ -104,16 +210,27 @@ void Shade::compile_module()
 
 	//DebugFlag = true;
 
-	OwningPtr<MemoryBuffer> buffer;
-		
-	LLVM_ERROR(MemoryBuffer::getFile("external.bc", buffer));
+	uint64_t start = Shade::CompileStats::ticks();
+
+	Module *module = ParseBitcodeFile(buffer, getGlobalContext());
+
+	if(!module)
+		Shade::error("Unable to parse the bitcode");
+
+	Shade::CompileStats::add(Shade::CompileStats::Parse, start);
 
-	Module *module = ParseBitcodeFile(buffer.get(), getGlobalContext());
 	auto &functions = module->getFunctionList();
+
+	start = Shade::CompileStats::ticks();
 	
 	GlobalVariable *ctors = module->getNamedGlobal("llvm.global_ctors");
 
-	create_ctor_func(module, ctors);
+	if(entry_points || module->getFunction("ctors"))
+		create_ctor_func(module, ctors);
+
+	bake_layout(module);
+
+	Shade::CompileStats::add(Shade::CompileStats::Prepare, start);
 
 	goto skip_random;
 	
@@ -160,39 +277,105 @@ void Shade::compile_module()
 skip_random:
 	module->dump();
 
+	start = Shade::CompileStats::ticks();
+
 	verifyModule(*module); 
-	
-	EngineBuilder engine_builder(module);
 
-	engine_builder.setEngineKind(EngineKind::JIT);
-	engine_builder.setRelocationModel(Reloc::Static);
-	engine_builder.setCodeModel(CodeModel::Small);
-	engine_builder.setOptLevel(CodeGenOpt::Default);
-	
-	OwningPtr<TargetMachine> target(engine_builder.selectTarget());
+	Shade::CompileStats::add(Shade::CompileStats::Prepare, start);
 
-	FunctionPassManager pass_manager(module);
+	void *init;
 
-	pass_manager.add(new TargetData(*target->getTargetData()));
-	
-	Engine engine(module, *target->getTargetData());
-	Emitter emitter(engine, *target, code_section, data_section);
+	generate(module, code, data, [&](Shade::Engine &engine, Shade::Emitter &emitter) {
+		image.capture(code, true);
+		image.capture(data, false);
+		image.fixups = emitter.Fixups;
 
-	if(target->addPassesToEmitMachineCode(pass_manager, emitter))
-	{
-		llvm::report_fatal_error("Target does not support machine code emission!");
-	}
+		for(auto i = engine.FunctionMap.begin(); i != engine.FunctionMap.end(); ++i)
+		{
+			if(i->first->hasName())
+				image.symbols[i->first->getName().str()] = (char *)i->second;
+		}
 
-	for(auto i = functions.begin(); i != functions.end(); ++i)
+		cacheable = emitter.Cacheable;
+
+		// "llvm.global_ctors" Array of constructors
+
+		init = entry_points ? engine.getPointerToFunction("init") : 0;
+	});
+
+	return init;
+}
+
+/*
+	The compiled module is cached in external.cache. Other instances started with the same
+	bitcode and layout profile only relocate and write the cached image instead of running LLVM.
+*/
+void Shade::compile_module()
+{
+	srand(GetTickCount());
+
+	install_fatal_error_handler(fatal_error_handler);
+
+	Engine::modules.push_back("user32.dll");
+	Engine::modules.push_back("kernel32.dll");
+	Engine::modules.push_back("ntdll.dll");
+
+	OwningPtr<MemoryBuffer> buffer;
+		
+	LLVM_ERROR(MemoryBuffer::getFile("external.bc", buffer));
+
+	LARGE_INTEGER frequency, start, stop;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	CompileStats::reset("external.bc");
+
+	uint64_t key = Image::key(buffer->getBufferStart(), buffer->getBufferSize());
+
+	Image image;
+	void *init;
+
+	if(image.load("external.cache", key))
 	{
-		pass_manager.run(*i);
+		std::map<std::string, void *> linked;
+
+		image.link(code_section, data_section, linked);
+
+		auto symbol = linked.find("init");
+
+		if(symbol == linked.end())
+			error("The cached image has no init function");
+
+		init = symbol->second;
+
+		CompileStats::current.cached = true;
+		CompileStats::add(CompileStats::Link, start.QuadPart);
+
+		QueryPerformanceCounter(&stop);
+
+		printf("Linked cached module (%u fixups) in %.2f ms\n", (unsigned)image.fixups.size(), (double)(stop.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
 	}
+	else
+	{
+		bool cacheable;
 
-	emitter.resolveRelocations();
+		init = compile(buffer.get(), code_section, data_section, image, cacheable);
 
-	// "llvm.global_ctors" Array of constructors
+		QueryPerformanceCounter(&stop);
 
-	void *init = engine.getPointerToFunction("init");
+		printf("Compiled module in %.2f ms\n", (double)(stop.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
+
+		if(cacheable)
+			image.save("external.cache", key);
+		else
+			printf("The compiled module refers to addresses which can't be relocated and won't be cached\n");
+	}
+
+	CompileStats::current.fixups = image.fixups.size();
+
+	CompileStats::write("compile-stats.json", std::vector<CompileStats::Module>(1, CompileStats::current));
+	CompileStats::stop();
 
 	DWORD thread_id;
 
@@ -216,3 +399,83 @@ skip_random:
 
 	detour((void *)shared->d3d_present_offset, shared->d3d_present, shared->d3d_present);
 }
+
+/*
+	Compiles each bitcode file into this process instead of the game and writes the statistics for all of them
+	to 'output'. Nothing is cached or run. This must be called before d3c_init. Each module gets its own sections,
+	which are freed afterwards, so the sections d3c_init uses for the game start out empty.
+*/
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_compile_benchmark(const char **paths, size_t count, const char *output)
+{
+	return Shade::wrap([&] {
+		if(Shade::process)
+			Shade::error("The compile benchmark must run before d3c_init");
+
+		install_fatal_error_handler(fatal_error_handler);
+
+		Shade::Engine::modules.push_back("user32.dll");
+		Shade::Engine::modules.push_back("kernel32.dll");
+		Shade::Engine::modules.push_back("ntdll.dll");
+
+		Shade::init_disassembler();
+
+		// The code and data sections are allocated and written through the process handle
+		Shade::process = GetCurrentProcess();
+
+		std::vector<Shade::CompileStats::Module> modules;
+
+		auto restore = [&] {
+			Shade::CompileStats::stop();
+			Shade::Engine::modules.clear();
+			Shade::process = 0;
+		};
+
+		try
+		{
+			for(size_t i = 0; i < count; ++i)
+			{
+				OwningPtr<MemoryBuffer> buffer;
+
+				LLVM_ERROR(MemoryBuffer::getFile(paths[i], buffer));
+
+				Shade::CompileStats::reset(paths[i]);
+
+				Shade::RemoteHeap code(PAGE_EXECUTE_READ);
+				Shade::RemoteHeap data(PAGE_READWRITE);
+				Shade::Image image;
+				bool cacheable;
+
+				auto free_page = [](void *address, size_t length) {
+					VirtualFree(address, 0, MEM_RELEASE);
+				};
+
+				try
+				{
+					compile(buffer.get(), code, data, image, cacheable, false);
+				}
+				catch(...)
+				{
+					code.each_page(free_page);
+					data.each_page(free_page);
+					throw;
+				}
+
+				code.each_page(free_page);
+				data.each_page(free_page);
+
+				Shade::CompileStats::current.fixups = image.fixups.size();
+
+				modules.push_back(Shade::CompileStats::current);
+			}
+		}
+		catch(...)
+		{
+			restore();
+			throw;
+		}
+
+		restore();
+
+		Shade::CompileStats::write(output, modules);
+	});
+}
@@ -2,9 +2,17 @@
 #include "../shade.hpp"
 #include "remote-heap.hpp"
 
+namespace llvm
+{
+	class Module;
+};
+
 namespace Shade
 {
 	extern RemoteHeap code_section;
 
 	void compile_module();
+
+	// Generates code for a module built on the host after compile_module and returns the address of the function. Takes ownership of the module.
+	void *compile_function(llvm::Module *module, const std::string &name);
 };
\ No newline at end of file
@@ -17,7 +17,10 @@ void Shade::detour(void *address, void *target, void *&trampoline)
 
 	auto list = instrlist_create(dr);
 	
-	byte instr_data[instr_max];
+	// The instructions overwritten by the jump start in the first 5 bytes, so they are read at once
+	byte instr_data[instr_max + 4];
+
+	read(address, instr_data, sizeof(instr_data));
 
 	byte *current = (byte *)address;
 	byte *min_pos = (byte *)address + 5;
@@ -25,11 +28,10 @@ void Shade::detour(void *address, void *target, void *&trampoline)
 
 	while(current < min_pos)
 	{
-		read(current, instr_data, instr_max);
-
 		auto instr = instr_create(dr);
 
-		byte *decoded = decode_from_copy(dr, instr_data, current, instr);
+		byte *local = instr_data + (current - (byte *)address);
+		byte *decoded = decode_from_copy(dr, local, current, instr);
 
 		if(!decoded)
 			error("Unknown instruction");
@@ -37,7 +39,7 @@ void Shade::detour(void *address, void *target, void *&trampoline)
 		instrlist_append(list, instr);
 		instr_make_persistent(dr, instr);
 
-		current += (size_t)(decoded - instr_data);
+		current += (size_t)(decoded - local);
 		
 		size += instr_length(dr, instr);
 	}
@@ -58,8 +60,6 @@ void Shade::detour(void *address, void *target, void *&trampoline)
 
 	instrlist_clear_and_destroy(dr, list);
 	
-	write(remote, local_trampoline, size);
-
 	trampoline = remote;
 
 	char code[5];
@@ -70,8 +70,13 @@ void Shade::detour(void *address, void *target, void *&trampoline)
 	
 	*(DWORD *)(code + 1) = offset;
 	
+	WriteQueue writes;
+
+	writes.add(remote, local_trampoline, size);
+	writes.add(address, code, 5);
+
 	access(address, 5, [&] {
-		write(address, code, 5);
+		writes.flush();
 	});
 }
 
@@ -79,7 +84,9 @@ void Shade::init_disassembler()
 {
 	disassemble_set_syntax(DR_DISASM_INTEL);
 
-	code_log.open("code_log.txt");
+	// The compile benchmark may have opened it already
+	if(!code_log.is_open())
+		code_log.open("code_log.txt");
 }
 
 static void print_instr(byte *address, instr_t *instr)
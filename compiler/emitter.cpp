@@ -7,6 +7,7 @@
 #include "engine.hpp"
 #include "disassembler.hpp"
 #include "remote-heap.hpp"
+#include "stats.hpp"
 
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Constants.h"
@@ -56,29 +57,61 @@ static bool isNonGhostDeclaration(const Function *F) {
 namespace Shade
 {
 Emitter::Emitter(Engine &engine, llvm::TargetMachine &TM, RemoteHeap &code_section, RemoteHeap &data_section)
-	: SizeEstimate(0), code_size(0), engine(engine), TM(TM), code_section(code_section), data_section(data_section), TD(*TM.getTargetData()),
-    EmittedFunctions(this) {
+	: SizeEstimate(0), code_size(0), Retries(0), engine(engine), TM(TM), code_section(code_section), data_section(data_section), TD(*TM.getTargetData()),
+    Cacheable(true) {
+}
+
+void Emitter::recordFixup(Image::Fixup::Kind Kind, void *Slot, void *Target, const std::string &External) {
+  Image::Fixup Fixup;
+  Fixup.kind = Kind;
+  Fixup.slot = (char *)Slot;
+  Fixup.target = (char *)Target;
+  Fixup.external = External;
+  Fixups.push_back(Fixup);
+}
+
+/// getExternalName - Returns the name of a function resolved by the engine
+/// outside the image, or an empty string for values in the image.
+std::string Emitter::getExternalName(const GlobalValue *V) {
+  if (const Function *F = dyn_cast<Function>(V))
+    if (F->isDeclaration() || F->hasAvailableExternallyLinkage())
+      return F->getName().str();
+  return std::string();
+}
+
+/// referencesGlobals - Returns true if the constant contains the address of a
+/// global value.
+bool Emitter::referencesGlobals(const Constant *C) {
+  if (isa<GlobalValue>(C))
+    return true;
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    if (referencesGlobals(cast<Constant>(C->getOperand(i))))
+      return true;
+  return false;
 }
 void Emitter::addRelocation(const MachineRelocation &MR) {
-    CurrentCode->Relocations.push_back(MR);
+    Relocations.push_back(MR);
 }
 
 void Emitter::StartMachineBasicBlock(MachineBasicBlock *MBB) {
-	MBB->getBasicBlock();
-    if (CurrentCode->MBBLocations.size() <= (unsigned)MBB->getNumber())
-    CurrentCode->MBBLocations.resize((MBB->getNumber()+1)*2);
-    CurrentCode->MBBLocations[MBB->getNumber()] = getCurrentPCValue();
+    size_t Index = CurrentCode->MBBBegin + MBB->getNumber();
+    // startFunction reserves room for every block ID, this only catches
+    // blocks created after that.
+    if (MBBLocations.size() <= Index)
+      MBBLocations.resize(Index + 1);
+    MBBLocations[Index] = getCurrentPCValue();
 
     DEBUG(dbgs() << "JIT: Emitting BB" << MBB->getNumber() << " at ["
                 << (void*) getCurrentPCValue() << "]\n");
 }
 
 uintptr_t Emitter::getMachineBasicBlockAddress(int index) const{
-    assert(CurrentCode->MBBLocations.size() > (unsigned)index &&
-            CurrentCode->MBBLocations[index] && "MBB not emitted!");
+    size_t Index = CurrentCode->MBBBegin + index;
+    assert(MBBLocations.size() > Index &&
+            MBBLocations[Index] && "MBB not emitted!");
     assert(CurrentCode->Target && "Target not emitted!");
 
-    return (uintptr_t)CurrentCode->Target + CurrentCode->MBBLocations[index] - (uintptr_t)CurrentCode->AlignedStart;
+    return (uintptr_t)CurrentCode->Target + MBBLocations[Index] - (uintptr_t)CurrentCode->AlignedStart;
 }
 
 uintptr_t Emitter::getMachineBasicBlockAddress(MachineBasicBlock *MBB) const{
@@ -125,7 +158,11 @@ void *Emitter::getGlobalVariableAddress(const GlobalVariable *V)
 	if (!V->isThreadLocal())
 		engine.InitializeMemory(V->getInitializer(), local);
 
-	write(remote, local, S);
+	// Addresses in initializers aren't tracked, so the image can't be relocated
+	if (!V->isThreadLocal() && referencesGlobals(V->getInitializer()))
+		Cacheable = false;
+
+	writes.add(remote, local, S);
 
 	GlobalOffsets[V] = remote;
 
@@ -181,7 +218,9 @@ void *Emitter::getGlobalValueIndirectSym(GlobalValue *GV, void *GVAddress) {
 
 	*local = GVAddress;
 
-	write(remote, local, size);
+	writes.add(remote, local, size);
+
+	recordFixup(Image::Fixup::Absolute, remote, GVAddress, getExternalName(GV));
 
 	IndirectSymMap[GV] = remote;
 
@@ -229,12 +268,21 @@ void Emitter::startFunction(MachineFunction &F) {
   BufferBegin = CurBufferPtr = startFunctionBody(F.getFunction(), ActualSize);
   BufferEnd = BufferBegin+ActualSize;
 
-  EmittedCode &code = EmittedFunctions[F.getFunction()];
+  // Functions are emitted one at a time, so nothing is added to
+  // EmittedFunctions while CurrentCode points into it.
+  EmittedFunctions.push_back(EmittedCode());
+  EmittedCode &code = EmittedFunctions.back();
   code.Function = F.getFunction();
 
   CurrentCode = &code;
 
   code.FunctionBody = BufferBegin;
+  code.RelocationBegin = Relocations.size();
+  code.MBBBegin = MBBLocations.size();
+  code.ConstPoolBegin = ConstPoolAddresses.size();
+  code.JumpTableBegin = JumpTableOffsets.size();
+
+  MBBLocations.resize(code.MBBBegin + F.getNumBlockIDs());
 
   // Ensure the constant pool/jump table info is at least 4-byte aligned.
   emitAlignment(16);
@@ -280,16 +328,23 @@ bool Emitter::finishFunction(MachineFunction &F) {
   DEBUG(dbgs() << "JIT: Finished CodeGen of [" << (void*)CurrentCode->Code
         << "] Function: " << F.getFunction()->getName()
 		<< ": " << (CurrentCode->Size) << " bytes of text, "
-        << CurrentCode->Relocations.size() << " relocations\n");
+        << (Relocations.size() - CurrentCode->RelocationBegin) << " relocations\n");
 
-  ConstPoolAddresses.clear();
+  CurrentCode->RelocationEnd = Relocations.size();
 
-	for (unsigned i = 0, e = CurrentCode->Relocations.size(); i != e; ++i)
+	CompileStats::Function Stats = {F.getFunction()->getName().str(), CurrentCode->Size, CurrentCode->RelocationEnd - CurrentCode->RelocationBegin, Retries, 0.0};
+
+	if(CompileStats::recording)
+		CompileStats::current.functions.push_back(Stats);
+
+	Retries = 0;
+
+	for (size_t i = CurrentCode->RelocationBegin, e = CurrentCode->RelocationEnd; i != e; ++i)
 	{
-		MachineRelocation &MR = CurrentCode->Relocations[i];
+		MachineRelocation &MR = Relocations[i];
 
 		if(MR.isBasicBlock())
-			CurrentCode->Relocations[i] = MachineRelocation::getBB(MR.getMachineCodeOffset(), MR.getRelocationType(), (llvm::MachineBasicBlock *)MR.getBasicBlock()->getNumber(), MR.getConstantVal());
+			Relocations[i] = MachineRelocation::getBB(MR.getMachineCodeOffset(), MR.getRelocationType(), (llvm::MachineBasicBlock *)MR.getBasicBlock()->getNumber(), MR.getConstantVal());
 	}
 
   return false;
@@ -299,15 +354,21 @@ void Emitter::resolveRelocations()
 {
 	for(auto code = EmittedFunctions.begin(); code != EmittedFunctions.end(); ++code)
 	{
-		CurrentCode = &code->second;
+		CurrentCode = &*code;
 
-		if (!CurrentCode->Relocations.empty()) {
+		uint64_t Start = CompileStats::ticks();
+
+		if (CurrentCode->RelocationEnd != CurrentCode->RelocationBegin) {
 		// Resolve the relocations to concrete pointers.
-		for (unsigned i = 0, e = CurrentCode->Relocations.size(); i != e; ++i) {
-		  MachineRelocation &MR = CurrentCode->Relocations[i];
+		for (size_t i = CurrentCode->RelocationBegin, e = CurrentCode->RelocationEnd; i != e; ++i) {
+		  MachineRelocation &MR = Relocations[i];
 		  void *ResultPtr = 0;
-		  if (!MR.letTargetResolve()) {
+		  std::string External;
+		  if (MR.letTargetResolve()) {
+			Cacheable = false;
+		  } else {
 			if (MR.isExternalSymbol()) {
+			  External = MR.getExternalSymbol();
 				std::cout << "External symbol: '" << MR.getExternalSymbol()  << "'" << std::endl;
 			  ResultPtr = engine.getPointerToNamedFunction(MR.getExternalSymbol(), false);
 			  DEBUG(dbgs() << "JIT: Map \'" << MR.getExternalSymbol() << "\' to ["
@@ -316,6 +377,7 @@ void Emitter::resolveRelocations()
 			  ResultPtr = getPointerToGlobal(MR.getGlobalValue(),
 											 BufferBegin+MR.getMachineCodeOffset(),
 											 MR.mayNeedFarStub());
+			  External = getExternalName(MR.getGlobalValue());
 			} else if (MR.isIndirectSymbol()) {
 			  ResultPtr = getPointerToGVIndirectSym(
 				  MR.getGlobalValue(), BufferBegin+MR.getMachineCodeOffset());
@@ -329,6 +391,23 @@ void Emitter::resolveRelocations()
 			  ResultPtr=(void*)getJumpTableEntryAddress(MR.getJumpTableIndex());
 			}
 
+			void *Slot = (uint8_t *)CurrentCode->Target + ((uint8_t *)CurrentCode->FunctionBody + MR.getMachineCodeOffset() - (uint8_t *)CurrentCode->AlignedStart);
+
+			switch(MR.getRelocationType())
+			{
+				case 0: // X86::reloc_pcrel_word
+					recordFixup(Image::Fixup::Relative, Slot, ResultPtr, External);
+					break;
+
+				case 2: // X86::reloc_absolute_word
+				case 3: // X86::reloc_absolute_word_sext
+					recordFixup(Image::Fixup::Absolute, Slot, ResultPtr, External);
+					break;
+
+				default:
+					Cacheable = false;
+			}
+
 			if(MR.getRelocationType() == 0) // X86::reloc_pcrel_word
 			{
 				uintptr_t offset = (uintptr_t)CurrentCode->AlignedStart - (uintptr_t)CurrentCode->FunctionBody;
@@ -340,37 +419,57 @@ void Emitter::resolveRelocations()
 		  }
 		}
 
-		TM.getJITInfo()->relocate(CurrentCode->FunctionBody, &CurrentCode->Relocations[0], CurrentCode->Relocations.size(), nullptr);
+		TM.getJITInfo()->relocate(CurrentCode->FunctionBody, &Relocations[CurrentCode->RelocationBegin], CurrentCode->RelocationEnd - CurrentCode->RelocationBegin, nullptr);
 	  }
+
+		CompileStats::add(CompileStats::Relocate, Start);
+
+		Start = CompileStats::ticks();
 		
 		uint8_t *target = (uint8_t *)CurrentCode->Target + ((uint8_t *)CurrentCode->Code - (uint8_t *)CurrentCode->AlignedStart);
 
 		Shade::code_log << "Function " << CurrentCode->Function->getName().str() << " starting at 0x" << (void *)target << std::endl;
 
 		Shade::disassemble_code(CurrentCode->Code, target, (uint8_t *)CurrentCode->End - (uint8_t *)CurrentCode->Code);
-		write(CurrentCode->Target, CurrentCode->AlignedStart, CurrentCode->Size);
+
+		CompileStats::add(CompileStats::Disassemble, Start);
+
+		writes.add(CurrentCode->Target, CurrentCode->AlignedStart, CurrentCode->Size);
 	}
+
+	uint64_t Start = CompileStats::ticks();
+
+	writes.flush();
+
+	CompileStats::add(CompileStats::Write, Start);
 }
 
 void Emitter::retryWithMoreMemory(MachineFunction &F) {
   DEBUG(dbgs() << "JIT: Ran out of space for native code.  Reattempting.\n");
-  ConstPoolAddresses.clear();
+  Retries++;
   deallocateMemForFunction(F.getFunction());
   // Try again with at least twice as much free space.
   SizeEstimate = (uintptr_t)(2 * (BufferEnd - BufferBegin));
 }
 
 /// deallocateMemForFunction - Deallocate all memory for the specified
-/// function body.  Also drop any references the function has to stubs.
-/// May be called while the Function is being destroyed inside ~Value().
+/// function body.  This is only done when retrying the function being
+/// emitted, whose entries are at the end of the pools, so they're truncated.
 void Emitter::deallocateMemForFunction(const Function *F) {
-  ValueMap<const Function *, EmittedCode, EmittedFunctionConfig>::iterator
-    Emitted = EmittedFunctions.find(F);
-  if (Emitted != EmittedFunctions.end()) {
-    deallocateFunctionBody(Emitted->second.FunctionBody);
+  if (EmittedFunctions.empty() || EmittedFunctions.back().Function != F)
+    return;
 
-    EmittedFunctions.erase(Emitted);
-  }
+  EmittedCode &Emitted = EmittedFunctions.back();
+
+  deallocateFunctionBody(Emitted.FunctionBody);
+
+  Relocations.erase(Relocations.begin() + Emitted.RelocationBegin, Relocations.end());
+  MBBLocations.resize(Emitted.MBBBegin);
+  ConstPoolAddresses.resize(Emitted.ConstPoolBegin);
+  JumpTableOffsets.resize(Emitted.JumpTableBegin);
+
+  EmittedFunctions.pop_back();
+  CurrentCode = 0;
 }
 
 
@@ -410,6 +509,7 @@ void Emitter::emitConstantPool(MachineConstantPool *MCP) {
 
     uintptr_t CAddr = (uintptr_t)ConstantPoolBase + Offset;
     ConstPoolAddresses.push_back(CAddr);
+    CurrentCode->ConstPoolCount++;
     if (CPE.isMachineConstantPoolEntry()) {
       // FIXME: add support to lower machine constant pool values into bytes!
       report_fatal_error("Initialize memory with machine specific constant pool"
@@ -445,6 +545,7 @@ void Emitter::initJumpTableInfo(MachineJumpTableInfo *MJTI) {
   JumpTable = MJTI;
   JumpTableBase = allocateSpace(NumEntries * EntrySize,
                              MJTI->getEntryAlignment(TD));
+  CurrentCode->JumpTableBase = JumpTableBase;
 }
 
 void Emitter::emitJumpTableInfo(MachineJumpTableInfo *MJTI) {
@@ -455,9 +556,14 @@ void Emitter::emitJumpTableInfo(MachineJumpTableInfo *MJTI) {
   if (JT.empty() || JumpTableBase == 0) return;
 
   CurrentCode->JumpTableEntrySize = JumpTable->getEntrySize(TD);
+  CurrentCode->JumpTableCount = JT.size();
 
-  for(unsigned i = 0; i < JT.size(); ++i)
-     CurrentCode->JumpTableOffsets.push_back(JT[i].MBBs.size());
+  // Stored as prefix sums, so each table's first entry is found directly
+  size_t Entries = 0;
+  for(unsigned i = 0; i < JT.size(); ++i) {
+     JumpTableOffsets.push_back(Entries);
+     Entries += JT[i].MBBs.size();
+  }
 
   switch (MJTI->getEntryKind()) {
   case MachineJumpTableInfo::EK_Inline:
@@ -476,8 +582,12 @@ void Emitter::emitJumpTableInfo(MachineJumpTableInfo *MJTI) {
       const std::vector<MachineBasicBlock*> &MBBs = JT[i].MBBs;
       // Store the address of the basic block for this jump table slot in the
       // memory we allocated for the jump table in 'initJumpTableInfo'
-      for (unsigned mi = 0, me = MBBs.size(); mi != me; ++mi)
-        *SlotPtr++ = getMachineBasicBlockAddress(MBBs[mi]);
+      for (unsigned mi = 0, me = MBBs.size(); mi != me; ++mi) {
+        void *Slot = (uint8_t *)CurrentCode->Target + ((uint8_t *)SlotPtr - (uint8_t *)CurrentCode->AlignedStart);
+        *SlotPtr = getMachineBasicBlockAddress(MBBs[mi]);
+        recordFixup(Image::Fixup::Absolute, Slot, (void *)*SlotPtr, std::string());
+        ++SlotPtr;
+      }
     }
     break;
   }
@@ -523,10 +633,10 @@ void *Emitter::allocIndirectGV(const GlobalValue *GV,
 // method.
 //
 uintptr_t Emitter::getConstantPoolEntryAddress(unsigned ConstantNum) const {
-  assert(ConstantNum < ConstantPool->getConstants().size() &&
+  assert(ConstantNum < CurrentCode->ConstPoolCount &&
          "Invalid ConstantPoolIndex!");
   assert(CurrentCode->Target && "Target not emitted!");
-  return ConstPoolAddresses[ConstantNum] - (uintptr_t)CurrentCode->AlignedStart + (uintptr_t)CurrentCode->Target;
+  return ConstPoolAddresses[CurrentCode->ConstPoolBegin + ConstantNum] - (uintptr_t)CurrentCode->AlignedStart + (uintptr_t)CurrentCode->Target;
 }
 
 // getJumpTableEntryAddress - Return the address of the JumpTable with index
@@ -534,17 +644,11 @@ uintptr_t Emitter::getConstantPoolEntryAddress(unsigned ConstantNum) const {
 //
 uintptr_t Emitter::getJumpTableEntryAddress(unsigned Index) const {
   assert(CurrentCode->Target && "Target not emitted!");
-  assert(Index < CurrentCode->JumpTableOffsets.size() && "Invalid jump table index!");
+  assert(Index < CurrentCode->JumpTableCount && "Invalid jump table index!");
 
-  unsigned EntrySize = CurrentCode->JumpTableEntrySize;
+  size_t Offset = JumpTableOffsets[CurrentCode->JumpTableBegin + Index] * CurrentCode->JumpTableEntrySize;
 
-  unsigned Offset = 0;
-  for (unsigned i = 0; i < Index; ++i)
-	  Offset += CurrentCode->JumpTableOffsets[i];
-
-   Offset *= EntrySize;
-
-  return (uintptr_t)JumpTableBase - (uintptr_t)CurrentCode->AlignedStart + (uintptr_t)CurrentCode->Target + Offset;
+  return (uintptr_t)CurrentCode->JumpTableBase - (uintptr_t)CurrentCode->AlignedStart + (uintptr_t)CurrentCode->Target + Offset;
 }
 
 uint8_t *Emitter::startFunctionBody(const Function *F, uintptr_t &ActualSize)
@@ -575,13 +679,4 @@ void *Emitter::allocateGlobal(uintptr_t Size, unsigned Alignment) {
 	return 0;
 }
 
-void Emitter::EmittedFunctionConfig::onDelete(
-  Emitter *Emitter, const Function *F) {
-  Emitter->deallocateMemForFunction(F);
-}
-void Emitter::EmittedFunctionConfig::onRAUW(
-  Emitter *, const Function*, const Function*) {
-  report_fatal_error("The JIT doesn't know how to handle a"
-                   " RAUW on a value it has emitted.");
-}
 };
\ No newline at end of file
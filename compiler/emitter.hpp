@@ -4,11 +4,13 @@
 //
 
 #include "../shade.hpp"
+#include "image.hpp"
 
 namespace llvm
 {
 	class TargetMachine;
 	class TargetData;
+	class Constant;
 }
 
 #include <vector>
@@ -39,10 +41,6 @@ namespace Shade
     ///
     void *ConstantPoolBase;
 
-    /// ConstPoolAddresses - Addresses of individual constant pool entries.
-    ///
-    llvm::SmallVector<uintptr_t, 8> ConstPoolAddresses;
-
     /// JumpTable - The jump tables for the current function.
     ///
     llvm::MachineJumpTableInfo *JumpTable;
@@ -59,11 +57,21 @@ namespace Shade
 
 	size_t code_size;
 
+	// Times the current function has been emitted again with more memory
+	size_t Retries;
+
 	Engine &engine;
 
 	RemoteHeap &code_section;
 	RemoteHeap &data_section;
 
+	// Code and data are written to the remote process together when relocations are resolved
+	WriteQueue writes;
+
+    /// EmittedCode - A function which has been emitted. The per-function lists
+    /// are ranges in the pools below, which are shared by all functions.
+    /// Functions are emitted one at a time, so the ranges of the current
+    /// function are always at the end of the pools.
     struct EmittedCode {
 	  const llvm::Function *Function;
       void *FunctionBody;  // Beginning of the function's allocation.
@@ -72,25 +80,39 @@ namespace Shade
 	  void *End;
 	  void *Target;
 	  size_t Size;
-      std::vector<llvm::MachineRelocation> Relocations;
-	  std::vector<size_t> JumpTableOffsets;
+	  void *JumpTableBase;
 	  unsigned JumpTableEntrySize;
-	  
-		/// MBBLocations - This vector is a mapping from MBB ID's to their address.
-		/// It is filled in by the StartMachineBasicBlock callback and queried by
-		/// the getMachineBasicBlockAddress callback.
-		std::vector<uintptr_t> MBBLocations;
 
+	  size_t RelocationBegin;
+	  size_t RelocationEnd;
+	  size_t MBBBegin;
+	  size_t ConstPoolBegin;
+	  size_t ConstPoolCount;
+	  size_t JumpTableBegin;
+	  size_t JumpTableCount;
 
-      EmittedCode() : FunctionBody(0), Code(0), Target(0), End(0), AlignedStart(0) {}
-    };
-    struct EmittedFunctionConfig : public llvm::ValueMapConfig<const llvm::Function*> {
-      typedef Emitter *ExtraData;
-      static void onDelete(Emitter *, const llvm::Function*);
-      static void onRAUW(Emitter *, const llvm::Function*, const llvm::Function*);
+      EmittedCode() : Function(0), FunctionBody(0), AlignedStart(0), Code(0), End(0), Target(0), Size(0), JumpTableBase(0), JumpTableEntrySize(0),
+		RelocationBegin(0), RelocationEnd(0), MBBBegin(0), ConstPoolBegin(0), ConstPoolCount(0), JumpTableBegin(0), JumpTableCount(0) {}
     };
-    llvm::ValueMap<const llvm::Function *, EmittedCode,
-             EmittedFunctionConfig> EmittedFunctions;
+
+    /// EmittedFunctions - The emitted functions in the order they were
+    /// emitted. The index is the function id.
+    std::vector<EmittedCode> EmittedFunctions;
+
+    /// Relocations - The relocations of all functions.
+    std::vector<llvm::MachineRelocation> Relocations;
+
+    /// MBBLocations - The address of each MBB, indexed by MBBBegin plus the
+    /// MBB number. It is filled in by the StartMachineBasicBlock callback and
+    /// queried by the getMachineBasicBlockAddress callback.
+    std::vector<uintptr_t> MBBLocations;
+
+    /// ConstPoolAddresses - Addresses of individual constant pool entries.
+    std::vector<uintptr_t> ConstPoolAddresses;
+
+    /// JumpTableOffsets - The index of the first entry of each jump table
+    /// within the jump tables of its function, so lookups don't sum sizes.
+    std::vector<size_t> JumpTableOffsets;
 	
 	EmittedCode *CurrentCode;
 
@@ -132,7 +154,18 @@ namespace Shade
 
 	void *getGlobalVariableAddress(const llvm::GlobalVariable *V);
 	void *getGlobalValueIndirectSym(llvm::GlobalValue *GV, void *GVAddress);
+
+	void recordFixup(Image::Fixup::Kind Kind, void *Slot, void *Target, const std::string &External);
+	static std::string getExternalName(const llvm::GlobalValue *V);
+	static bool referencesGlobals(const llvm::Constant *C);
   public:
+	/// Fixups - Every value written to the remote process which refers to an
+	/// address in it, recorded so the code can be cached in an Image.
+	std::vector<Image::Fixup> Fixups;
+
+	/// Cacheable - False if the code contains addresses which can't be fixed up.
+	bool Cacheable;
+
     Emitter(Engine &engine, llvm::TargetMachine &TM, RemoteHeap &code_section, RemoteHeap &data_section);
     ~Emitter() {
     }
@@ -69,6 +69,11 @@ throw_error:
 std::vector<std::string> Engine::modules;
 
 void *Engine::getPointerToNamedFunction(const std::string &Name, bool AbortOnFailure)
+{
+	return find_external(Name, AbortOnFailure);
+}
+
+void *Engine::find_external(const std::string &name, bool abort_on_failure)
 {
 	for(auto i = modules.begin(); i != modules.end(); ++i)
 	{
@@ -77,13 +82,13 @@ void *Engine::getPointerToNamedFunction(const std::string &Name, bool AbortOnFai
 		if(!module)
 			win32_error("Unable to get module handle of '" + *i + "'");
 
-		void *result = GetProcAddress(module, Name.c_str());
+		void *result = GetProcAddress(module, name.c_str());
 
 		if(result)
 			return result;
 	}
-  if(AbortOnFailure)
-	  error("Linking error: Unknown external function '" + Name + "'");
+  if(abort_on_failure)
+	  error("Linking error: Unknown external function '" + name + "'");
 
   return 0;
 }
@@ -60,6 +60,9 @@ public:
   ///
   virtual void *getPointerToNamedFunction(const std::string &Name,
                                           bool AbortOnFailure = true);
+
+	// Looks up an external function in the modules available to remote code
+	static void *find_external(const std::string &name, bool abort_on_failure);
 };
 };
 
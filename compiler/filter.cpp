@@ -0,0 +1,303 @@
+#include "filter.hpp"
+#include "compiler.hpp"
+#include "../profile.hpp"
+#include "../requests.hpp"
+
+#include <unordered_map>
+
+#include <llvm/LLVMContext.h>
+#include <llvm/Module.h>
+#include <llvm/Constants.h>
+#include <llvm/DerivedTypes.h>
+#include <llvm/Support/IRBuilder.h>
+#include <llvm/ADT/OwningPtr.h>
+
+using namespace llvm;
+
+static std::unordered_map<std::string, void *> compiled;
+
+static const char *type_names[] = {"Actor", "ActorCommonData"};
+
+// Generates IR for an expression while parsing it
+class Parser
+{
+	const char *start;
+	const char *current;
+	std::string prefix;
+	IRBuilder<> &builder;
+	Value *object;
+
+	prelude_noreturn void fail(const std::string &message)
+	{
+		Shade::error(message + " in filter expression at '" + std::string(current) + "' in '" + start + "'");
+	}
+
+	void skip_space()
+	{
+		while(*current == ' ' || *current == '\t')
+			current++;
+	}
+
+	bool accept(const char *token)
+	{
+		skip_space();
+
+		size_t length = strlen(token);
+
+		if(strncmp(current, token, length) != 0)
+			return false;
+
+		current += length;
+
+		return true;
+	}
+
+	size_t field()
+	{
+		skip_space();
+
+		const char *name_start = current;
+
+		while(isalnum((unsigned char)*current) || *current == '_')
+			current++;
+
+		if(current == name_start)
+			fail("Expected a field");
+
+		std::string name = prefix + std::string(name_start, current);
+
+		for(size_t i = 0; i < Shade::Layout::Count; ++i)
+		{
+			if(name == Shade::Layout::values[i].name)
+				return Shade::Layout::values[i].value;
+		}
+
+		current = name_start;
+		fail("Unknown field");
+	}
+
+	Value *byte_at(size_t offset)
+	{
+		return builder.CreateLoad(builder.CreateConstGEP1_32(object, offset));
+	}
+
+	Value *string_comparison(size_t offset, bool equal)
+	{
+		std::string text;
+
+		while(*current != '"')
+		{
+			if(!*current)
+				fail("Unterminated string");
+
+			text += *current++;
+		}
+
+		current++;
+
+		Value *result = builder.getTrue();
+
+		// The terminator is compared too so "Monk" doesn't match "Monkey"
+		for(size_t i = 0; i <= text.size(); ++i)
+			result = builder.CreateAnd(result, builder.CreateICmpEQ(byte_at(offset + i), builder.getInt8(text.c_str()[i])));
+
+		return equal ? result : builder.CreateNot(result);
+	}
+
+	Value *comparison()
+	{
+		size_t offset = field();
+
+		enum Operator {Equal, NotEqual, LessEqual, GreaterEqual, Less, Greater} op;
+
+		if(accept("=="))
+			op = Equal;
+		else if(accept("!="))
+			op = NotEqual;
+		else if(accept("<="))
+			op = LessEqual;
+		else if(accept(">="))
+			op = GreaterEqual;
+		else if(accept("<"))
+			op = Less;
+		else if(accept(">"))
+			op = Greater;
+		else
+			fail("Expected a comparison");
+
+		if(accept("\""))
+		{
+			if(op != Equal && op != NotEqual)
+				fail("Strings can only be compared with == and !=");
+
+			return string_comparison(offset, op == Equal);
+		}
+
+		skip_space();
+
+		char *end;
+		int64_t number = _strtoi64(current, &end, 0);
+
+		if(end == current)
+			fail("Expected a number or string");
+
+		// Fields are 32 bits, so literals may be written signed or unsigned like 0xFFFFFFFF
+		if(number < INT32_MIN || number > UINT32_MAX)
+			fail("Number out of range");
+
+		current = end;
+
+		Value *address = builder.CreateBitCast(builder.CreateConstGEP1_32(object, offset), builder.getInt32Ty()->getPointerTo());
+		Value *value = builder.CreateLoad(address);
+		Value *constant = builder.getInt32((uint32_t)number);
+
+		switch(op)
+		{
+			case Equal:
+				return builder.CreateICmpEQ(value, constant);
+
+			case NotEqual:
+				return builder.CreateICmpNE(value, constant);
+
+			case LessEqual:
+				return builder.CreateICmpSLE(value, constant);
+
+			case GreaterEqual:
+				return builder.CreateICmpSGE(value, constant);
+
+			case Less:
+				return builder.CreateICmpSLT(value, constant);
+
+			default:
+				return builder.CreateICmpSGT(value, constant);
+		}
+	}
+
+	Value *unary()
+	{
+		if(accept("!"))
+			return builder.CreateNot(unary());
+
+		if(accept("("))
+		{
+			Value *result = disjunction();
+
+			if(!accept(")"))
+				fail("Expected ')'");
+
+			return result;
+		}
+
+		return comparison();
+	}
+
+	// Fields are plain loads from the object, so both sides are evaluated instead of branching
+	Value *conjunction()
+	{
+		Value *result = unary();
+
+		while(accept("&&"))
+			result = builder.CreateAnd(result, unary());
+
+		return result;
+	}
+
+	Value *disjunction()
+	{
+		Value *result = conjunction();
+
+		while(accept("||"))
+			result = builder.CreateOr(result, conjunction());
+
+		return result;
+	}
+
+public:
+	Parser(const std::string &expression, const std::string &prefix, IRBuilder<> &builder, Value *object) :
+		start(expression.c_str()),
+		current(expression.c_str()),
+		prefix(prefix),
+		builder(builder),
+		object(object)
+	{
+	}
+
+	Value *parse()
+	{
+		Value *result = disjunction();
+
+		skip_space();
+
+		if(*current)
+			fail("Unexpected input");
+
+		return result;
+	}
+};
+
+void *Shade::Filter::compile(Type type, const std::string &expression)
+{
+	std::string key = std::string(type_names[type]) + ":" + expression;
+
+	auto result = compiled.find(key);
+
+	if(result != compiled.end())
+		return result->second;
+
+	LLVMContext &context = getGlobalContext();
+
+	// Owned here until compile_function hands it to the engine, so parse errors don't leak it
+	OwningPtr<Module> module(new Module("filter", context));
+
+	llvm::Type *i8_ptr = llvm::Type::getInt8PtrTy(context);
+
+	// The remote code calls this as int (*)(void *) with the default calling convention.
+	// Returning i1 isn't used since the caller doesn't know if the upper bits of the register are cleared.
+	FunctionType *function_type = FunctionType::get(llvm::Type::getInt32Ty(context), i8_ptr, false);
+	Function *function = Function::Create(function_type, Function::ExternalLinkage, "filter", module.get());
+
+	IRBuilder<> builder(BasicBlock::Create(context, "entry", function));
+
+	Parser parser(expression, std::string(type_names[type]) + ".", builder, function->arg_begin());
+
+	builder.CreateRet(builder.CreateZExt(parser.parse(), llvm::Type::getInt32Ty(context)));
+
+	void *code = compile_function(module.take(), "filter");
+
+	compiled[key] = code;
+
+	return code;
+}
+
+void Shade::Filter::set(Type type, const std::string &expression)
+{
+	auto filter = expression.empty() ? 0 : (int (*)(void *))compile(type, expression);
+
+	switch(type)
+	{
+		case Actor:
+			shared->filters.actor = filter;
+			break;
+
+		case ActorCommonData:
+			shared->filters.acd = filter;
+			break;
+	}
+
+	// Snapshots made with the old filter mustn't be served anymore
+	Requests::invalidate();
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_filter_actors(const char *expression)
+{
+	return Shade::wrap([&] {
+		Shade::Filter::set(Shade::Filter::Actor, expression ? expression : "");
+	});
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_filter_acds(const char *expression)
+{
+	return Shade::wrap([&] {
+		Shade::Filter::set(Shade::Filter::ActorCommonData, expression ? expression : "");
+	});
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "../shade.hpp"
+
+namespace Shade
+{
+	/*
+		Predicates compiled to native code and run by the remote traversals, so objects which aren't
+		wanted are never copied to the shared heap. Expressions compare fields with integers or strings
+		and combine the comparisons with &&, || and !, like:
+			id != -1 && (world_id == 0x7A1 || name == "Monk")
+		Fields are the layout entries of the type (see layout.hpp) and are read as signed 32-bit integers.
+		Comparing a field with a string compares the characters at the field with the string and its terminator.
+		Compiled predicates are kept for the lifetime of the process and reused for the same expression.
+	*/
+	namespace Filter
+	{
+		enum Type
+		{
+			Actor,
+			ActorCommonData
+		};
+
+		void *compile(Type type, const std::string &expression);
+
+		// Sets the predicate used when listing objects of the type. An empty expression removes it.
+		void set(Type type, const std::string &expression);
+	};
+};
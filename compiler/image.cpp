@@ -0,0 +1,277 @@
+#include "image.hpp"
+#include "engine.hpp"
+#include "../profile.hpp"
+
+#include <fstream>
+#include <sstream>
+
+static const uint32_t image_magic = 0x494D4853; // "SHMI"
+static const uint32_t image_version = 2;
+
+static uint64_t hash(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+uint64_t Shade::Image::key(const void *bitcode, size_t size)
+{
+	uint64_t result = hash(0xCBF29CE484222325ull, &image_version, sizeof(image_version));
+
+	result = hash(result, bitcode, size);
+
+	// The layout profile is folded into the code by bake_layout
+	for(size_t i = 0; i < Layout::Count; ++i)
+		result = hash(result, &Layout::values[i].value, sizeof(Layout::values[i].value));
+
+	return result;
+}
+
+template<class T> static void write_value(std::ostream &file, const T &value)
+{
+	file.write((const char *)&value, sizeof(T));
+}
+
+template<class T> static bool read_value(std::istream &file, T &value)
+{
+	return !file.read((char *)&value, sizeof(T)).fail();
+}
+
+static void write_string(std::ostream &file, const std::string &string)
+{
+	write_value(file, (uint32_t)string.size());
+	file.write(string.c_str(), string.size());
+}
+
+static bool read_string(std::istream &file, std::string &string)
+{
+	uint32_t size;
+
+	if(!read_value(file, size) || size > 0x1000)
+		return false;
+
+	string.resize(size);
+
+	return !size || !file.read(&string[0], size).fail();
+}
+
+bool Shade::Image::load(const std::string &filename, uint64_t key)
+{
+	std::ifstream input(filename.c_str(), std::ios::binary);
+
+	uint32_t magic, payload_size;
+	uint64_t file_key, checksum;
+
+	if(!read_value(input, magic) || magic != image_magic || !read_value(input, file_key) || file_key != key)
+		return false;
+
+	if(!read_value(input, checksum) || !read_value(input, payload_size))
+		return false;
+
+	// The code is injected into the game, so a truncated or damaged payload must not be parsed
+	std::string payload(payload_size, 0);
+
+	if(payload_size && !input.read(&payload[0], payload_size))
+		return false;
+
+	if(hash(0xCBF29CE484222325ull, payload.data(), payload.size()) != checksum)
+		return false;
+
+	std::istringstream file(payload);
+
+	uint32_t segment_count, fixup_count, symbol_count;
+
+	if(!read_value(file, segment_count) || !read_value(file, fixup_count) || !read_value(file, symbol_count))
+		return false;
+
+	segments.resize(segment_count);
+
+	for(auto segment = segments.begin(); segment != segments.end(); ++segment)
+	{
+		uint32_t size;
+
+		if(!read_value(file, segment->base) || !read_value(file, segment->code) || !read_value(file, size))
+			return false;
+
+		segment->data.resize(size);
+
+		if(size && !file.read(&segment->data[0], size))
+			return false;
+	}
+
+	fixups.resize(fixup_count);
+
+	for(auto fixup = fixups.begin(); fixup != fixups.end(); ++fixup)
+	{
+		uint32_t kind;
+
+		if(!read_value(file, kind) || !read_value(file, fixup->slot) || !read_value(file, fixup->target) || !read_string(file, fixup->external))
+			return false;
+
+		fixup->kind = (Fixup::Kind)kind;
+	}
+
+	for(uint32_t i = 0; i < symbol_count; ++i)
+	{
+		std::string name;
+		char *address;
+
+		if(!read_string(file, name) || !read_value(file, address))
+			return false;
+
+		symbols[name] = address;
+	}
+
+	return true;
+}
+
+void Shade::Image::save(const std::string &filename, uint64_t key)
+{
+	std::ostringstream file;
+
+	write_value(file, (uint32_t)segments.size());
+	write_value(file, (uint32_t)fixups.size());
+	write_value(file, (uint32_t)symbols.size());
+
+	for(auto segment = segments.begin(); segment != segments.end(); ++segment)
+	{
+		write_value(file, segment->base);
+		write_value(file, segment->code);
+		write_value(file, (uint32_t)segment->data.size());
+		file.write(&segment->data[0], segment->data.size());
+	}
+
+	for(auto fixup = fixups.begin(); fixup != fixups.end(); ++fixup)
+	{
+		write_value(file, (uint32_t)fixup->kind);
+		write_value(file, fixup->slot);
+		write_value(file, fixup->target);
+		write_string(file, fixup->external);
+	}
+
+	for(auto symbol = symbols.begin(); symbol != symbols.end(); ++symbol)
+	{
+		write_string(file, symbol->first);
+		write_value(file, symbol->second);
+	}
+
+	std::string payload = file.str();
+
+	/*
+		Instances started together may all save the image. Each one writes its own temporary file
+		which replaces the old image in one step, so readers never see a mix of two writers.
+	*/
+	std::ostringstream temporary;
+
+	temporary << filename << "." << GetCurrentProcessId() << ".tmp";
+
+	{
+		std::ofstream output(temporary.str().c_str(), std::ios::binary | std::ios::trunc);
+
+		write_value(output, image_magic);
+		write_value(output, key);
+		write_value(output, hash(0xCBF29CE484222325ull, payload.data(), payload.size()));
+		write_value(output, (uint32_t)payload.size());
+		output.write(payload.data(), payload.size());
+
+		if(!output)
+		{
+			output.close();
+			DeleteFileA(temporary.str().c_str());
+			error("Unable to write " + temporary.str());
+		}
+	}
+
+	// The replace fails if another instance has the image open, which then has an equally good copy
+	if(!MoveFileExA(temporary.str().c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+		DeleteFileA(temporary.str().c_str());
+}
+
+void Shade::Image::capture(RemoteHeap &heap, bool code)
+{
+	std::vector<Transfer> transfers;
+
+	heap.each_page([&](void *address, size_t length) {
+		Segment segment;
+
+		segment.base = (char *)address;
+		segment.code = code;
+		segments.push_back(segment);
+		segments.back().data.resize(length);
+
+		Transfer transfer = {address, 0, length, false};
+
+		transfers.push_back(transfer);
+	});
+
+	// The segments vector is complete so the buffers won't move
+	for(size_t i = 0; i < transfers.size(); ++i)
+		transfers[i].local = &segments[segments.size() - transfers.size() + i].data[0];
+
+	if(read_batch(transfers))
+		win32_error("Unable to read compiled code");
+}
+
+void Shade::Image::link(RemoteHeap &code_section, RemoteHeap &data_section, std::map<std::string, void *> &linked)
+{
+	std::map<Segment *, ptrdiff_t> deltas;
+
+	for(auto segment = segments.begin(); segment != segments.end(); ++segment)
+	{
+		char *base = (char *)(segment->code ? code_section : data_section).allocate(segment->data.size(), 16);
+
+		deltas[&*segment] = base - segment->base;
+	}
+
+	// There are only a few segments, one for each page of the remote heaps
+	auto find_segment = [&](char *address) -> Segment * {
+		for(auto segment = segments.begin(); segment != segments.end(); ++segment)
+		{
+			if(address >= segment->base && address < segment->base + segment->data.size())
+				return &*segment;
+		}
+
+		error("Fixup refers to an address outside the image");
+	};
+
+	for(auto fixup = fixups.begin(); fixup != fixups.end(); ++fixup)
+	{
+		Segment *segment = find_segment(fixup->slot);
+
+		ptrdiff_t target_shift;
+
+		if(fixup->external.empty())
+			target_shift = deltas[find_segment(fixup->target)];
+		else
+			target_shift = (char *)Engine::find_external(fixup->external, true) - fixup->target;
+
+		if(fixup->kind == Fixup::Relative)
+			target_shift -= deltas[segment];
+
+		char *slot = &segment->data[fixup->slot - segment->base];
+		uint32_t value;
+
+		memcpy(&value, slot, sizeof(value));
+
+		value += (uint32_t)target_shift;
+
+		memcpy(slot, &value, sizeof(value));
+	}
+
+	WriteQueue writes;
+
+	for(auto segment = segments.begin(); segment != segments.end(); ++segment)
+		writes.add(segment->base + deltas[&*segment], &segment->data[0], segment->data.size());
+
+	writes.flush();
+
+	for(auto symbol = symbols.begin(); symbol != symbols.end(); ++symbol)
+		linked[symbol->first] = symbol->second + deltas[find_segment(symbol->second)];
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "../shade.hpp"
+#include "remote-heap.hpp"
+#include <map>
+
+namespace Shade
+{
+	/*
+		A compiled module which can be linked into a process without running code generation.
+		It contains the code and data pages as they were written to the process which compiled it,
+		and fixups for every 32-bit value referring to an address which will be different in another process.
+		Addresses are stored as they were in the original process and are only used as keys while linking.
+	*/
+	class Image
+	{
+	public:
+		struct Segment
+		{
+			char *base;
+			bool code;
+			std::vector<char> data;
+		};
+
+		struct Fixup
+		{
+			enum Kind
+			{
+				Absolute, // The value is the address of the target
+				Relative // The value is the displacement from the end of the value to the target
+			};
+
+			Kind kind;
+			char *slot; // Address of the value
+			char *target; // Address the value refers to
+			std::string external; // Name of the external function for targets outside the image
+		};
+
+		std::vector<Segment> segments;
+		std::vector<Fixup> fixups;
+		std::map<std::string, char *> symbols;
+
+		// Hashes the bitcode and everything compile_module bakes into the code
+		static uint64_t key(const void *bitcode, size_t size);
+
+		bool load(const std::string &filename, uint64_t key);
+		void save(const std::string &filename, uint64_t key);
+
+		// Adds the pages of a remote heap with their current content
+		void capture(RemoteHeap &heap, bool code);
+
+		/*
+			Allocates the segments from the remote heaps, applies the fixups and writes the result to the process.
+			Returns the new address of each symbol in 'linked'.
+		*/
+		void link(RemoteHeap &code_section, RemoteHeap &data_section, std::map<std::string, void *> &linked);
+	};
+};
@@ -78,6 +78,13 @@ namespace Shade
 				};
 			}
 			
+			// Calls func(address, length) for each page allocated so far
+			template<typename F> void each_page(F func)
+			{
+				for(auto page = pages.begin(); page != pages.end(); ++page)
+					func((*page)->address, (*page)->length);
+			}
+
 			void *allocate(size_t bytes, size_t alignment)
 			{
 				char *result = (char *)Prelude::align((size_t)current, alignment);
@@ -0,0 +1,113 @@
+#include "stats.hpp"
+#include <fstream>
+
+using namespace Shade;
+
+CompileStats::Module CompileStats::current;
+bool CompileStats::recording;
+
+static const char *phase_names[CompileStats::PhaseCount] = {
+	"parse",
+	"prepare",
+	"codegen",
+	"relocate",
+	"disassemble",
+	"write",
+	"link"
+};
+
+void CompileStats::reset(const std::string &name)
+{
+	current.name = name;
+	current.cached = false;
+	current.fixups = 0;
+	current.functions.clear();
+
+	for(size_t i = 0; i < PhaseCount; ++i)
+		current.phases[i] = 0.0;
+
+	recording = true;
+}
+
+void CompileStats::stop()
+{
+	recording = false;
+}
+
+uint64_t CompileStats::ticks()
+{
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+
+	return now.QuadPart;
+}
+
+double CompileStats::add(Phase phase, uint64_t start)
+{
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceFrequency(&frequency);
+
+	double ms = (double)(ticks() - start) * 1000.0 / frequency.QuadPart;
+
+	current.phases[phase] += ms;
+
+	return ms;
+}
+
+static std::string quote(const std::string &str)
+{
+	std::string result = "\"";
+
+	for(auto c = str.begin(); c != str.end(); ++c)
+	{
+		if(*c == '"' || *c == '\\')
+			result += '\\';
+
+		if((unsigned char)*c < 0x20)
+			result += ' ';
+		else
+			result += *c;
+	}
+
+	return result + "\"";
+}
+
+void CompileStats::write(const std::string &path, const std::vector<Module> &modules)
+{
+	std::ofstream file(path.c_str(), std::ios::trunc);
+
+	if(!file)
+		error("Unable to create " + path);
+
+	file << "{\"modules\": [";
+
+	for(auto module = modules.begin(); module != modules.end(); ++module)
+	{
+		if(module != modules.begin())
+			file << ",";
+
+		file << "\n\t{\"name\": " << quote(module->name) << ", \"cached\": " << (module->cached ? "true" : "false") << ", \"fixups\": " << module->fixups << ",\n";
+		file << "\t\"phases_ms\": {";
+
+		for(size_t i = 0; i < PhaseCount; ++i)
+			file << (i ? ", " : "") << "\"" << phase_names[i] << "\": " << module->phases[i];
+
+		file << "},\n\t\"functions\": [";
+
+		for(auto function = module->functions.begin(); function != module->functions.end(); ++function)
+		{
+			file << (function != module->functions.begin() ? "," : "") << "\n\t\t{\"name\": " << quote(function->name)
+				<< ", \"size\": " << function->size << ", \"relocations\": " << function->relocations
+				<< ", \"retries\": " << function->retries << ", \"codegen_ms\": " << function->codegen_ms << "}";
+		}
+
+		file << "]}";
+	}
+
+	file << "\n]}\n";
+
+	if(!file)
+		error("Unable to write " + path);
+}
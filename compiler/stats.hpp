@@ -0,0 +1,58 @@
+#pragma once
+#include "../shade.hpp"
+
+namespace Shade
+{
+	/*
+		Timings and sizes collected while compiling the remote module, written as JSON so startup regressions
+		can be compared between builds. Phase times include everything done in the phase, so the per-function
+		code generation times add up to less than the Codegen phase.
+	*/
+	namespace CompileStats
+	{
+		enum Phase
+		{
+			Parse,
+			Prepare, // Constructors, layout constants and verification
+			Codegen,
+			Relocate,
+			Disassemble,
+			Write, // Writing code and data to the process
+			Link, // Linking a cached image instead of the phases above
+			PhaseCount
+		};
+
+		struct Function
+		{
+			std::string name;
+			size_t size;
+			size_t relocations;
+			size_t retries; // Times the code didn't fit and was emitted again
+			double codegen_ms;
+		};
+
+		struct Module
+		{
+			std::string name;
+			bool cached;
+			size_t fixups;
+			double phases[PhaseCount]; // Milliseconds
+			std::vector<Function> functions;
+		};
+
+		extern Module current;
+
+		// Functions are only recorded between reset and stop, so later compiles like filters don't add to them
+		extern bool recording;
+
+		void reset(const std::string &name);
+		void stop();
+
+		uint64_t ticks();
+
+		// Adds the time since 'start' to 'phase' and returns it in milliseconds
+		double add(Phase phase, uint64_t start);
+
+		void write(const std::string &path, const std::vector<Module> &modules);
+	};
+};
@@ -11,6 +11,9 @@ extern "C" {
 
 #define D3C_API __cdecl
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef struct d3c_error
 {
 	const char *message;
@@ -19,9 +22,228 @@ typedef struct d3c_error
 typedef void (D3C_API *d3c_tick_t)();
 
 D3C_EXPORT d3c_error_t D3C_API d3c_init();
+
+/*
+	Sets the number of threads started in the game process for post-processing remote calls, like copying
+	world geometry. Must be called before d3c_init. Defaults to one less than the number of processors, up to 8.
+	0 runs everything on the render thread.
+*/
+D3C_EXPORT void D3C_API d3c_set_remote_workers(size_t count);
 D3C_EXPORT d3c_error_t D3C_API d3c_loop(d3c_tick_t tick_func);
 D3C_EXPORT void D3C_API d3c_free_error(d3c_error_t error);
 
+/*
+	Snapshots of the game state. The data is built by the remote code in the shared mapping and the
+	accessors return pointers straight into it, so nothing is copied. Strings are null terminated.
+	A snapshot can only be acquired from the tick callback and it must be released before the callback returns.
+	Pointers returned by the accessors are invalid once the snapshot is released.
+	Snapshots acquired again within the request TTL, by the same or other threads, share one remote call.
+	A thread can only hold one snapshot at a time.
+*/
+typedef struct d3c_snapshot *d3c_snapshot_t;
+typedef struct d3c_actor *d3c_actor_t;
+typedef struct d3c_acd *d3c_acd_t;
+typedef struct d3c_ui_node *d3c_ui_node_t;
+
+D3C_EXPORT d3c_error_t D3C_API d3c_snapshot_acquire(d3c_snapshot_t *snapshot);
+D3C_EXPORT void D3C_API d3c_snapshot_release(d3c_snapshot_t snapshot);
+
+/*
+	Sets the number of ticks after the one a result was made in for which snapshots, movement polls and world
+	geometry are served without a new remote call. Defaults to 0, which only shares results within a tick.
+*/
+D3C_EXPORT void D3C_API d3c_set_request_ttl(size_t frames);
+
+/*
+	Recording writes every acquired snapshot with its time to segment files named <path>.0000, <path>.0001 and so on.
+	Replaying calls tick_func once for each recorded snapshot without a game. The callback acquires the snapshots as usual.
+	'speed' scales the recorded time between snapshots, so 1 is real time and 0 replays as fast as possible.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_record_start(const char *path);
+D3C_EXPORT d3c_error_t D3C_API d3c_record_stop();
+D3C_EXPORT d3c_error_t D3C_API d3c_replay(const char *path, double speed, d3c_tick_t tick_func);
+
+/* Encodes the actors and ACDs of a recording into columns stored in <path>.columns and prints the ratio and throughput */
+D3C_EXPORT d3c_error_t D3C_API d3c_compress_recording(const char *path);
+
+/* Cursors return NULL at the end of the list */
+D3C_EXPORT d3c_actor_t D3C_API d3c_first_actor(d3c_snapshot_t snapshot);
+D3C_EXPORT d3c_actor_t D3C_API d3c_next_actor(d3c_actor_t actor);
+D3C_EXPORT const char *D3C_API d3c_actor_name(d3c_actor_t actor);
+D3C_EXPORT uint32_t D3C_API d3c_actor_id(d3c_actor_t actor);
+D3C_EXPORT uint32_t D3C_API d3c_actor_acd_id(d3c_actor_t actor);
+D3C_EXPORT uint32_t D3C_API d3c_actor_world_id(d3c_actor_t actor);
+D3C_EXPORT const void *D3C_API d3c_actor_ptr(d3c_actor_t actor); /* Address in the game */
+
+/*
+	Stores up to 'max' actors with 'fragment' in their name in 'actors' and returns the number of matches.
+	The names are indexed across snapshots, so repeated searches don't scan the names again.
+	The index is locked, so modules running in parallel can search the shared snapshot.
+*/
+D3C_EXPORT size_t D3C_API d3c_find_actors(d3c_snapshot_t snapshot, const char *fragment, d3c_actor_t *actors, size_t max);
+
+D3C_EXPORT d3c_acd_t D3C_API d3c_first_acd(d3c_snapshot_t snapshot);
+D3C_EXPORT d3c_acd_t D3C_API d3c_next_acd(d3c_acd_t acd);
+D3C_EXPORT const char *D3C_API d3c_acd_name(d3c_acd_t acd);
+D3C_EXPORT uint32_t D3C_API d3c_acd_id(d3c_acd_t acd);
+D3C_EXPORT uint32_t D3C_API d3c_acd_owner_id(d3c_acd_t acd);
+D3C_EXPORT const void *D3C_API d3c_acd_ptr(d3c_acd_t acd); /* Address in the game */
+
+/*
+	Queries over the actors or ACDs of a snapshot copied into columns of 32 bit integers. Actors have the columns
+	ptr, name, id, acd_id and world_id and ACDs have ptr, name, id and owner_id. Names are ids from the name index.
+	A query selects all rows when it's created and each filter keeps the selected rows which match the comparison.
+	Queries don't refer to the snapshot after they are created and each can be used by one thread at a time.
+*/
+typedef struct d3c_query *d3c_query_t;
+
+typedef enum d3c_query_source
+{
+	D3C_QUERY_ACTORS,
+	D3C_QUERY_ACDS
+} d3c_query_source_t;
+
+typedef enum d3c_compare
+{
+	D3C_EQUAL,
+	D3C_NOT_EQUAL,
+	D3C_LESS,
+	D3C_LESS_EQUAL,
+	D3C_GREATER,
+	D3C_GREATER_EQUAL
+} d3c_compare_t;
+
+typedef struct d3c_group
+{
+	int32_t key;
+	size_t count;
+	int64_t sum;
+} d3c_group_t;
+
+D3C_EXPORT d3c_error_t D3C_API d3c_query_create(d3c_snapshot_t snapshot, d3c_query_source_t source, d3c_query_t *query);
+D3C_EXPORT void D3C_API d3c_query_free(d3c_query_t query);
+D3C_EXPORT d3c_error_t D3C_API d3c_query_filter(d3c_query_t query, const char *column, d3c_compare_t compare, int32_t value);
+
+/* Keeps the 'count' selected rows with the lowest values in 'column', or the highest if 'descending' is nonzero, in order */
+D3C_EXPORT d3c_error_t D3C_API d3c_query_top(d3c_query_t query, const char *column, size_t count, int descending);
+
+/* Stores the values in 'column' of up to 'max' selected rows in 'values' and sets 'count' to the number of selected rows */
+D3C_EXPORT d3c_error_t D3C_API d3c_query_values(d3c_query_t query, const char *column, int32_t *values, size_t max, size_t *count);
+
+/*
+	Counts the selected rows for each value in 'key' and sums the values in 'value' for them, unless it's NULL.
+	Stores up to 'max' groups sorted by key in 'groups' and sets 'count' to the number of groups.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_query_group(d3c_query_t query, const char *key, const char *value, d3c_group_t *groups, size_t max, size_t *count);
+
+D3C_EXPORT d3c_ui_node_t D3C_API d3c_ui_root(d3c_snapshot_t snapshot);
+D3C_EXPORT size_t D3C_API d3c_ui_child_count(d3c_ui_node_t node);
+D3C_EXPORT d3c_ui_node_t D3C_API d3c_ui_child(d3c_ui_node_t node, size_t index);
+D3C_EXPORT const char *D3C_API d3c_ui_name(d3c_ui_node_t node);
+D3C_EXPORT const char *D3C_API d3c_ui_text(d3c_ui_node_t node); /* NULL if the node has no text */
+D3C_EXPORT int D3C_API d3c_ui_visible(d3c_ui_node_t node);
+D3C_EXPORT uint64_t D3C_API d3c_ui_hash(d3c_ui_node_t node);
+D3C_EXPORT const float *D3C_API d3c_ui_rect(d3c_ui_node_t node); /* Left, top, right and bottom or NULL if the node has no rectangle */
+D3C_EXPORT const void *D3C_API d3c_ui_ptr(d3c_ui_node_t node); /* Address in the game */
+
+/*
+	Looks up the UI component with 'hash' by reading the game's component map directly, without a remote call
+	or a snapshot, so it can be called at any time after d3c_init. Sets 'ptr' to the address of the component
+	in the game or NULL if it doesn't exist.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_find_ui_component(uint64_t hash, const void **ptr);
+
+/*
+	Sets how UI components with the virtual table at 'vtable' in the 1.0.3.10235 executable are listed.
+	Components with unknown virtual tables are listed as containers. Like snapshots, this can only be called
+	from the tick callback while no snapshot is acquired.
+*/
+typedef enum d3c_ui_kind
+{
+	D3C_UI_LEAF, /* No children */
+	D3C_UI_CONTAINER, /* Children are listed */
+	D3C_UI_CONTROL /* Children are listed, and text and rectangles are listed if visible */
+} d3c_ui_kind_t;
+
+D3C_EXPORT d3c_error_t D3C_API d3c_register_ui_type(uint32_t vtable, d3c_ui_kind_t kind);
+
+/*
+	Sets a predicate compiled to native code which selects the actors or ACDs listed by snapshots.
+	Expressions compare fields from the layout profile with numbers or strings and combine them
+	with &&, || and !, like: world_id == 0x7A1 && name != "Monk". NULL removes the predicate.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_filter_actors(const char *expression);
+D3C_EXPORT d3c_error_t D3C_API d3c_filter_acds(const char *expression);
+
+/*
+	Polls the movement of all actors. Like snapshots, this can only be called from the tick callback while
+	no snapshot is acquired. Between polls, d3c_predict_position extrapolates the position of an actor
+	'delay' seconds from now and sets 'error' to an estimated bound for the distance to the real position.
+	It returns 0 if the actor hasn't been polled.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_movement_update();
+D3C_EXPORT int D3C_API d3c_predict_position(uint32_t actor_id, double delay, float position[3], float *error);
+
+/*
+	Navigation data for the loaded scenes of a world. It's extracted again when scenes are loaded or unloaded
+	and cached in memory and on disk, so later calls for the same scenes are cheap. Like snapshots, this can only
+	be called from the tick callback while no snapshot is acquired. The pointers stay valid until the next call
+	for the same world.
+*/
+typedef struct d3c_world *d3c_world_t;
+
+typedef struct d3c_cell
+{
+	float min_x;
+	float min_y;
+	float max_x;
+	float max_y;
+	uint32_t flags;
+} d3c_cell_t;
+
+D3C_EXPORT d3c_error_t D3C_API d3c_world_geometry(uint32_t world_id, d3c_world_t *world);
+D3C_EXPORT const float *D3C_API d3c_world_bounds(d3c_world_t world); /* Left, top, right and bottom */
+D3C_EXPORT size_t D3C_API d3c_world_cell_count(d3c_world_t world);
+D3C_EXPORT const d3c_cell_t *D3C_API d3c_world_cells(d3c_world_t world); /* Walkable cells in world coordinates */
+
+/*
+	Compiles each bitcode file in 'paths' into the calling process as a stand-in for the game and writes the time
+	spent in each phase and the size, relocations, retries and code generation time of each function to 'output'
+	as JSON. Must be called before d3c_init. d3c_init writes the same statistics for the remote module to compile-stats.json.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_compile_benchmark(const char **paths, size_t count, const char *output);
+
+/*
+	Plants 'count' patterns with wildcards in a synthetic image of 'size' bytes, scans it the way d3c_init scans the
+	game's main module and checks each result against a byte by byte search. Prints the scan throughput.
+*/
+D3C_EXPORT d3c_error_t D3C_API d3c_scan_benchmark(size_t size, size_t count);
+
+/*
+	Bot modules run once for each call to d3c_run_modules, which is meant to be called from the tick callback.
+	A module declares the data it uses, the action channels it reads and the channels it writes, as bit masks
+	where bit n stands for channel n.
+	Modules run after every module registered before them that writes a channel they read. Other modules run
+	in parallel on the thread pool, so they must only read the shared snapshot and not release it. While the
+	snapshot is held, requests for other data like world geometry fail instead of waiting for it.
+	Actions are writes to game memory. After all modules ran, they're submitted together, ordered by channel,
+	then by module registration order, then by the order they were emitted in. Reading a channel only orders
+	a module after its writers; their actions aren't in game memory or visible to it before the next tick.
+*/
+typedef struct d3c_module_context *d3c_module_context_t;
+typedef void (D3C_API *d3c_module_func_t)(d3c_module_context_t context, void *user);
+
+typedef enum d3c_data
+{
+	D3C_DATA_SNAPSHOT = 1, /* d3c_module_snapshot is valid */
+	D3C_DATA_MOVEMENT = 2 /* d3c_predict_position uses a poll from this tick, except during replays */
+} d3c_data_t;
+
+D3C_EXPORT d3c_error_t D3C_API d3c_module_register(const char *name, uint32_t data, uint32_t reads, uint32_t writes, d3c_module_func_t func, void *user);
+D3C_EXPORT d3c_snapshot_t D3C_API d3c_module_snapshot(d3c_module_context_t context);
+D3C_EXPORT void D3C_API d3c_module_emit(d3c_module_context_t context, uint32_t channel, void *address, const void *data, size_t size);
+D3C_EXPORT d3c_error_t D3C_API d3c_run_modules();
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -1,24 +1,31 @@
 #include "ui.hpp"
 #include "shared.hpp"
 #include "d3.hpp"
+#include "copy.hpp"
+#include "workers.hpp"
 
 namespace Shade
 {
 	namespace Remote
 	{
+		SHADE_ROW_COPY(Actor, Actor, SHADE_SCHEMA_ACTOR)
+		SHADE_ROW_COPY(ActorCommonData, ActorCommonData, SHADE_SCHEMA_ACTOR_COMMON_DATA)
+		
 		void list_actor_assets()
 		{
 			auto actors = new List<Actor>;
 			
 			auto list = (*D3::game_data)->get_object_list("RActors");
 			
+			auto filter = shared->filters.actor;
+			
 			list->each_object<D3::Actor>([&](D3::Actor *d3_actor) {
+				if(filter && !filter(d3_actor))
+					return;
+				
 				auto actor = new Actor;
 				
-				actor->ptr = d3_actor;
-				actor->id = d3_actor->id;
-				actor->acd_id = d3_actor->common_data_id;
-				actor->name = new String(d3_actor->name, sizeof(D3::Actor::name));
+				copy(actor, d3_actor);
 				
 				actors->append(actor);
 			});
@@ -32,18 +39,32 @@ namespace Shade
 			
 			auto list = (*D3::game_data)->get_object_list("ActorCommonData");
 			
+			auto filter = shared->filters.acd;
+			
 			list->each_object<D3::ActorCommonData>([&](D3::ActorCommonData *d3_acd) {
+				if(filter && !filter(d3_acd))
+					return;
+				
 				auto acd = new ActorCommonData;
 				
-				acd->ptr = d3_acd;
-				acd->id = d3_acd->id;
-				acd->owner_id = d3_acd->owner_id;
-				acd->name = new String(d3_acd->name, sizeof(D3::ActorCommonData::name));
+				copy(acd, d3_acd);
 				
 				acds->append(acd);
 			});
 			
 			shared->data.acds = acds;
 		}
+		
+		void list_assets()
+		{
+			auto func = [](size_t index) {
+				if(index == 0)
+					list_actor_assets();
+				else
+					list_acd_assets();
+			};
+			
+			Workers::run(2, func);
+		}
 	};
 };
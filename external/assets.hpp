@@ -1,33 +1,30 @@
 #pragma once
-#include "utils.hpp"
+#include "schema.hpp"
+
+#define SHADE_SCHEMA_ACTOR(self, value, string, text) \
+	self(ptr) \
+	string(Actor, name, name) \
+	value(Actor, size_t, id, id) \
+	value(Actor, size_t, acd_id, common_data_id) \
+	value(Actor, size_t, world_id, world_id)
+
+#define SHADE_SCHEMA_ACTOR_COMMON_DATA(self, value, string, text) \
+	self(ptr) \
+	string(ActorCommonData, name, name) \
+	value(ActorCommonData, size_t, id, id) \
+	value(ActorCommonData, size_t, owner_id, owner_id)
 
 namespace Shade
 {
 	namespace Remote
 	{
-		struct ActorCommonData:
-			public HeapObject
-		{
-			void *ptr;
-			Ptr<String> name;
-			size_t id;
-			size_t owner_id;
-			
-			Ptr<ActorCommonData> next;
-		};
-		
-		struct Actor:
-			public HeapObject
-		{
-			void *ptr;
-			Ptr<String> name;
-			size_t id;
-			size_t acd_id;
-			
-			Ptr<Actor> next;
-		};
+		SHADE_ROW(ActorCommonData, SHADE_SCHEMA_ACTOR_COMMON_DATA)
+		SHADE_ROW(Actor, SHADE_SCHEMA_ACTOR)
 		
 		void list_actor_assets();
 		void list_acd_assets();
+		
+		// Lists both actors and ACDs, in parallel if there are remote workers
+		void list_assets();
 	};
 };
@@ -1,4 +1,4 @@
 @echo off
-clang++ external.cpp d3.cpp heap.cpp ui.cpp shared.cpp utils.cpp assets.cpp -std=gnu++11 -ffreestanding -ccc-host-triple i686-pc-win32 -D_X86_ "-IC:\MinGW64\x86_64-w64-mingw32\include" -Os -Wall -fno-exceptions -fno-inline -emit-llvm -c
-llvm-link external.o d3.o heap.o ui.o shared.o utils.o assets.o  -o=../external.bc
+clang++ external.cpp d3.cpp heap.cpp log.cpp ui.cpp ui-types.cpp shared.cpp utils.cpp assets.cpp world.cpp movement.cpp workers.cpp -std=gnu++11 -ffreestanding -ccc-host-triple i686-pc-win32 -D_X86_ "-IC:\MinGW64\x86_64-w64-mingw32\include" -Os -Wall -fno-exceptions -fno-inline -emit-llvm -c
+llvm-link external.o d3.o heap.o log.o ui.o ui-types.o shared.o utils.o assets.o world.o movement.o workers.o  -o=../external.bc
 llvm-dis ../external.bc
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#include "schema.hpp"
+#include "d3.hpp"
+
+namespace Shade
+{
+	/*
+		Merges copies of adjacent fields into a single copy.
+		The addresses are constant offsets from the record and the game structure once compile_module has baked
+		the layout profile, so the checks fold away and only the merged copies remain.
+	*/
+	struct CopyRun
+	{
+		char *to;
+		const char *from;
+		size_t size;
+
+		CopyRun() : size(0) {}
+
+		__attribute__((always_inline)) void add(void *to, const void *from, size_t size)
+		{
+			if(this->size && (char *)to == this->to + this->size && (const char *)from == this->from + this->size)
+			{
+				this->size += size;
+				return;
+			}
+
+			flush();
+
+			this->to = (char *)to;
+			this->from = (const char *)from;
+			this->size = size;
+		}
+
+		__attribute__((always_inline)) void flush()
+		{
+			if(size)
+				__builtin_memcpy(to, from, size);
+
+			size = 0;
+		}
+	};
+
+	template<bool same_size> struct CopyValue
+	{
+		template<typename T, typename S> __attribute__((always_inline)) static void copy(CopyRun &run, T &to, S &from)
+		{
+			to = (T)from;
+		}
+	};
+	
+	template<> struct CopyValue<true>
+	{
+		template<typename T, typename S> __attribute__((always_inline)) static void copy(CopyRun &run, T &to, S &from)
+		{
+			run.add(&to, &from, sizeof(T));
+		}
+	};
+	
+	// Fields of the same size are copied as raw bytes so adjacent fields can be merged
+	template<typename T, typename S> __attribute__((always_inline)) void copy_value(CopyRun &run, T &to, S &from)
+	{
+		CopyValue<sizeof(T) == sizeof(S)>::copy(run, to, from);
+	}
+};
+
+#define SHADE_SCHEMA_COPY_SELF(name) record->name = source;
+#define SHADE_SCHEMA_COPY_VALUE(source_type, type, name, field) copy_value(run, record->name, d3_field(source, source_type, field));
+#define SHADE_SCHEMA_COPY_STRING(source_type, name, field) record->name = new String(d3_field(source, source_type, field), sizeof(D3::source_type::field));
+#define SHADE_SCHEMA_COPY_TEXT(source_type, name, field) if(d3_field(source, source_type, field)) record->name = new String(d3_field(source, source_type, field));
+
+#define SHADE_ROW_COPY(record_type, source_type, schema) \
+	void copy(record_type *record, D3::source_type *source) \
+	{ \
+		CopyRun run; \
+		schema(SHADE_SCHEMA_COPY_SELF, SHADE_SCHEMA_COPY_VALUE, SHADE_SCHEMA_COPY_STRING, SHADE_SCHEMA_COPY_TEXT) \
+		run.flush(); \
+	}
+
+#define SHADE_SCHEMA_APPEND_SELF(name) columns->name.get()[index] = source;
+#define SHADE_SCHEMA_APPEND_VALUE(source_type, type, name, field) columns->name.get()[index] = (type)d3_field(source, source_type, field);
+#define SHADE_SCHEMA_APPEND_STRING(source_type, name, field) columns->name.get()[index] = new String(d3_field(source, source_type, field), sizeof(D3::source_type::field));
+#define SHADE_SCHEMA_APPEND_TEXT(source_type, name, field) columns->name.get()[index] = d3_field(source, source_type, field) ? new String(d3_field(source, source_type, field)) : nullptr;
+
+#define SHADE_COLUMNS_COPY(columns_type, source_type, schema) \
+	void append(columns_type *columns, D3::source_type *source) \
+	{ \
+		size_t index = columns->count++; \
+		schema(SHADE_SCHEMA_APPEND_SELF, SHADE_SCHEMA_APPEND_VALUE, SHADE_SCHEMA_APPEND_STRING, SHADE_SCHEMA_APPEND_TEXT) \
+	}
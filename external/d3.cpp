@@ -6,7 +6,7 @@ namespace Shade
 	
 	void D3::init()
 	{
-		diablo_exe.delta = (size_t)GetModuleHandle(0) - 0x800000;
+		diablo_exe.delta = (size_t)GetModuleHandle(0) - Symbol::image_base;
 	}
 };
 
@@ -28,8 +28,15 @@ template<class Struct, size_t found_size, size_t expected_size> struct SizeTest
 
 #define verify_size(struct, size) SizeTest<Shade::D3::struct, sizeof(Shade::D3::struct), size>::test()
 
+#define verify_layout_field(struct, field, offset) static_assert(__builtin_offsetof(Shade::D3::struct, field) == offset, "Invalid layout default for " #struct "::" #field);
+
+#define verify_layout_size(struct, size) verify_size(struct, size);
+
 void verify_offsets()
 {
+	// The layout profile defaults must match the structures
+	SHADE_LAYOUT(verify_layout_field, verify_layout_size)
+	
 	verify_offset(ActorCommonData, guid_0, 0x88);
 	verify_offset(ActorCommonData, acd_gball, 0xB4);
 	verify_offset(ActorCommonData, position, 0xD0);
@@ -54,6 +61,8 @@ void verify_offsets()
 	verify_offset(ActorMovement, tp, 0x74);
 	verify_offset(ActorMovement, position_1, 0xA4);
 	verify_offset(ActorMovement, speed_1, 0xB8);
+	verify_offset(ActorMovement, actor_id, 0x15C);
+	verify_offset(ActorMovement, frame, 0x160);
 	verify_offset(ActorMovement, direction, 0x170);
 	
 	verify_offset(Actor, sno_id, 0x88);
@@ -1,5 +1,21 @@
 #pragma once
 #include "external.hpp"
+#include "shared.hpp"
+#include "layout.hpp"
+
+#define SHADE_LAYOUT_DECLARE_FIELD(type, field, offset) extern "C" const size_t layout_##type##_##field;
+#define SHADE_LAYOUT_DECLARE_SIZE(type, size) extern "C" const size_t layout_##type##_size;
+
+SHADE_LAYOUT(SHADE_LAYOUT_DECLARE_FIELD, SHADE_LAYOUT_DECLARE_SIZE)
+
+#undef SHADE_LAYOUT_DECLARE_FIELD
+#undef SHADE_LAYOUT_DECLARE_SIZE
+
+/*
+	Accesses a field listed in layout.hpp using the offset from the layout profile.
+	The type of the field is taken from the D3 structure.
+*/
+#define d3_field(object, type, field) (*(decltype(Shade::D3::type::field) *)((char *)(object) + layout_##type##_##field))
 
 namespace Shade
 {
@@ -16,13 +32,20 @@ namespace Shade
 		
 		static Module diablo_exe;
 		
-		template<typename T, size_t offset, Module *module = &diablo_exe> struct Offset
+		// Size of a structure listed in layout.hpp from the layout profile
+		template<class T> struct Size;
+		
+		/*
+			The address of each symbol is resolved by the host (see scanner.cpp) and stored in Shared::symbols
+			before init runs. The Value constructors run from ctors() after D3::init has set up the module delta.
+		*/
+		template<typename T, Symbol::Type symbol, Module *module = &diablo_exe> struct Offset
 		{
 			struct Value
 			{
 				T ptr;
 				
-				Value() : ptr((T)(offset + module->delta)) {}
+				Value() : ptr((T)(shared->symbols[symbol] + module->delta)) {}
 			};
 			
 			static Value value;
@@ -217,6 +240,7 @@ namespace Shade
 		};
 		
 		typedef HashTable<UIReference, UIComponent *> UIComponentMap;
+		typedef UIComponentMap::Pair UIComponentPair;
 		typedef HashTable<uint32_t, UIHandler *> UIHandlerMap;
 
 		struct UIManager
@@ -341,6 +365,38 @@ namespace Shade
 			void *u_12[2];
 		};
 		
+		/*
+			The Scene and NavCell layouts are unverified guesses for 1.0.3.10235.
+			Use the layout profile to correct them.
+		*/
+		struct NavCell
+		{
+			enum Flags
+			{
+				AllowWalk = 1
+			};
+			
+			Vector<3> min; // Relative to Scene::min
+			Vector<3> max;
+			uint16_t flags;
+			uint16_t neighbour_count;
+			uint32_t neighbours;
+		};
+		
+		struct Scene:
+			public BaseObject
+		{
+			guid_t sno_id;
+			guid_t world_id;
+			void *u_0[53];
+			Vector<2> min;
+			Vector<2> max;
+			void *u_1[36];
+			NavCell *cells;
+			uint32_t cell_count;
+			void *u_2[72];
+		};
+		
 		struct AttributeData
 		{
 			uint32_t flags;
@@ -380,27 +436,32 @@ namespace Shade
 			template<typename T, typename F> void each_object(F func)
 			{
 				size_t count = 0;
+				size_t size = d3_field(this, ObjectList, slot_size);
+				size_t total = d3_field(this, ObjectList, total_count);
+				auto slot_list = d3_field(this, ObjectList, slots);
 				
-				for(size_t j = 0; j < slot_size; ++j)
+				for(size_t j = 0; j < size; ++j)
 				{
-					auto array = static_cast<T *>(slots[j]);
+					auto array = (char *)slot_list[j];
 					
-					for(size_t i = 0; i < slot_size; ++i)
+					for(size_t i = 0; i < size; ++i)
 					{
-						auto current = &array[i];
+						auto current = (T *)(array + i * Size<T>::get());
 						
-						if(current->id != -1)
+						if(((BaseObject *)current)->id != -1)
 							func(current);
 						
 						count++;
 						
-						if(count >= total_count)
+						if(count >= total)
 							return;
 					}
 				}
 			}
 		};
 		
+		typedef LinkedList<ObjectList *>::Node ObjectListNode;
+		
 		struct GameData
 		{
 			void *u_0[228];
@@ -408,11 +469,11 @@ namespace Shade
 			
 			ObjectList *get_object_list(const char *type)
 			{
-				auto node = object_lists.first;
+				auto node = d3_field(this, GameData, object_lists).first;
 				
 				while(node)
 				{
-					if(strncmp(type, node->value->type, sizeof(ObjectList::type)) == 0)
+					if(strncmp(type, d3_field(node->value, ObjectList, type), sizeof(ObjectList::type)) == 0)
 						return node->value;
 					
 					node = node->next;
@@ -463,61 +524,74 @@ namespace Shade
 			void *players;
 		};
 		
-		static constexpr auto &ui_reference_list = Offset<UIReference *, 0x158E3B8>::value.ptr; // 1.0.3.10235
+		static constexpr auto &ui_reference_list = Offset<UIReference *, Symbol::UIReferenceList>::value.ptr; // 0x158E3B8 - 1.0.3.10235
 		
 		/* attribute_list
 			1.0.3.10235
+			0x157E518
 			setup_attribute_list  - 0x12ED010: Initializes this array
 		*/
-		static constexpr auto &attribute_list_list = Offset<AttributeData *, 0x157E518>::value.ptr; 
+		static constexpr auto &attribute_list_list = Offset<AttributeData *, Symbol::AttributeList>::value.ptr;
 		static const size_t attribute_list_size = 1032;
 		
 		/* ui_handler_list
 			1.0.3.10235
+			0x15924E0
 			setup_ui_handler_list - 0x1326620: Initializes this array
 			setup_ui_manager_handler_list - 0xB52120: populates this list into UIManager::handler_map
 			get_ui_handler_from_string - 0xB51F10: maps a string to UIHandler::execute using UIManager::handler_map
 		*/
-		static constexpr auto &ui_handler_list = Offset<UIHandler *, 0x15924E0>::value.ptr; 
+		static constexpr auto &ui_handler_list = Offset<UIHandler *, Symbol::UIHandlerList>::value.ptr;
 		static const size_t ui_handler_list_size = 920; // referenced in setup_ui_manager_handler_list
 		
-		static constexpr auto &object_manager = Offset<ObjectManager **, 0x15A1BEC>::value.ptr; // 1.0.3.10235
+		static constexpr auto &object_manager = Offset<ObjectManager **, Symbol::ObjectManager>::value.ptr; // 0x15A1BEC - 1.0.3.10235
 		
 		/* window_not_minimized
 			This variable is set to 0 when the window is minimized and to 1 when it isn't.
 			1.0.3.10235
+			0x157D2AC
 			MainWndProc - 0x80E5F0: Referenced in a function called at the end
 		*/
-		static constexpr auto &window_not_minimized = Offset<uint32_t **, 0x157D2AC>::value.ptr;
+		static constexpr auto &window_not_minimized = Offset<uint32_t **, Symbol::WindowNotMinimized>::value.ptr;
 		
 		/* game_data
 			1.0.3.10235
+			0x15A2EA4
 			Referenced in start of 0x9A62E0
 		*/
-		static constexpr auto &game_data = Offset<GameData **, 0x15A2EA4>::value.ptr;
+		static constexpr auto &game_data = Offset<GameData **, Symbol::GameData>::value.ptr;
 		
 		/* iterate_actor_objects
 			1.0.3.10235
+			0x9E58B0
 			'index' should be set to -1 when starting.
 			Increments 'index' and returns the asset in the 'asset' parameter and as the return value.
 			Returns 0 when 'index' is out of bounds.
 		*/
-		static constexpr auto &iterate_actor_objects = Offset<Actor *(__thiscall *)(ObjectList *object_list, short *index, Actor **actor), 0x9E58B0>::value.ptr;
+		static constexpr auto &iterate_actor_objects = Offset<Actor *(__thiscall *)(ObjectList *object_list, short *index, Actor **actor), Symbol::IterateActorObjects>::value.ptr;
 		
-		static constexpr auto &get_ui_component = Offset<UIComponent *(__cdecl *)(UIReference *reference), 0x93F400>::value.ptr; // 1.0.3.10235
+		static constexpr auto &get_ui_component = Offset<UIComponent *(__cdecl *)(UIReference *reference), Symbol::GetUIComponent>::value.ptr; // 0x93F400 - 1.0.3.10235
 		
 		/* extract_ui_rect
 			Extracts the virtual coordinates of the UIControl into the rect parameter
 		*/
-		static constexpr auto &extract_ui_rect = Offset<void (__thiscall *)(UIControl *element, UIRect *rect), 0xA85B80>::value.ptr; // 1.0.3.10235
+		static constexpr auto &extract_ui_rect = Offset<void (__thiscall *)(UIControl *element, UIRect *rect), Symbol::ExtractUIRect>::value.ptr; // 0xA85B80 - 1.0.3.10235
 		
 		/* map_ui_rect
 			Maps the virtual coordinates passed in 'in' and maps it to window coordinates which is stored in 'out'
 		*/
-		static constexpr auto &map_ui_rect = Offset<void (*)(UIRect *in, UIRect *out, bool x_axis, bool y_axis), 0xA8A230>::value.ptr; // 1.0.3.10235
+		static constexpr auto &map_ui_rect = Offset<void (*)(UIRect *in, UIRect *out, bool x_axis, bool y_axis), Symbol::MapUIRect>::value.ptr; // 0xA8A230 - 1.0.3.10235
 		
 		static void init();
 	};
 	
-	template<typename T, size_t offset, D3::Module *module> typename D3::Offset<T, offset, module>::Value D3::Offset<T, offset, module>::value;
+	template<typename T, Symbol::Type symbol, D3::Module *module> typename D3::Offset<T, symbol, module>::Value D3::Offset<T, symbol, module>::value;
+	
+	#define SHADE_LAYOUT_SIZE(type, size) template<> struct D3::Size<D3::type> { static size_t get() { return layout_##type##_size; } };
+	#define SHADE_LAYOUT_IGNORE(type, field, offset)
+	
+	SHADE_LAYOUT(SHADE_LAYOUT_IGNORE, SHADE_LAYOUT_SIZE)
+	
+	#undef SHADE_LAYOUT_SIZE
+	#undef SHADE_LAYOUT_IGNORE
 };
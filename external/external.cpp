@@ -2,6 +2,8 @@
 #include "shared.hpp"
 #include "d3.hpp"
 #include "ui.hpp"
+#include "ui-types.hpp"
+#include "workers.hpp"
 
 extern "C" void ctors();
 
@@ -20,18 +22,92 @@ namespace Shade
 			shared->error_type = error;
 		}
 		
-		void tick()
+		long seen_end;
+		size_t spin_limit = Handshake::spin_min;
+		
+		void signal_start()
+		{
+			// __sync_fetch_and_add is a full barrier, so 'parked' is read after the new sequence is visible
+			__sync_fetch_and_add(&shared->handshake_start.sequence, 1);
+			
+			if(shared->handshake_start.parked)
+				SetEvent(shared->event_start);
+		}
+		
+		/*
+			Reports running out of memory to the host and parks the thread, since the host terminates the process.
+			The host only wakes up when the start sequence changes, so it's signaled like the end of a call.
+			Only the thread in the call may signal the host, so workers leave their job instead and
+			the thread waiting for the job reports the error.
+		*/
+		void out_of_memory()
 		{
-			SetEvent(shared->event_start);
+			set_error(Error::OutOfMemory);
+			
+			if(!Workers::leave())
+				signal_start();
+			
+			Sleep(INFINITE);
+		}
+		
+		/*
+			Waits for the host to signal the end of a call, spinning before blocking like wait_event on the host.
+			Returns false if the controlling application was terminated.
+		*/
+		bool wait_end()
+		{
+			auto handshake = &shared->handshake_end;
+			
+			for(size_t i = 0; i < spin_limit; ++i)
+			{
+				if(handshake->sequence != seen_end)
+				{
+					seen_end = handshake->sequence;
+					
+					if(spin_limit < Handshake::spin_max)
+						spin_limit *= 2;
+					
+					return true;
+				}
+				
+				__asm__ __volatile__("pause");
+			}
+			
+			if(spin_limit > Handshake::spin_min)
+				spin_limit /= 2;
 			
 			while(true)
 			{
+				handshake->parked = 1;
+				
+				__sync_synchronize();
+				
+				if(handshake->sequence != seen_end)
+					break;
+				
 				auto result = WaitForMultipleObjects(2, &shared->event_end, FALSE, INFINITE);
 
 				if(result != WAIT_OBJECT_0) // The event was not triggered. This means the controlling application was terminated and we shouldn't do anything.
-					return;
+					return false;
 				
 				ResetEvent(shared->event_end);
+			}
+			
+			handshake->parked = 0;
+			
+			seen_end = handshake->sequence;
+			
+			return true;
+		}
+		
+		void tick()
+		{
+			signal_start();
+			
+			while(true)
+			{
+				if(!wait_end())
+					return;
 				
 				heap.reset();
 				
@@ -56,16 +132,36 @@ namespace Shade
 						list_acd_assets();
 						break;
 						
+					case Call::Snapshot:
+						list_ui();
+						list_assets();
+						break;
+						
+					case Call::ExtractWorld:
+						extract_world();
+						break;
+						
+					case Call::ListMovement:
+						list_movement();
+						break;
+						
+					case Call::RegisterUIType:
+						if(!register_ui_type(shared->ui_type.v_table, (UIType::Kind)shared->ui_type.kind))
+							shared->error_type = Error::NotFound;
+						break;
+						
 					case Call::Dummy:
 						break;
 				}
 				
+				shared->heap_used = heap.used();
+				
+				log(Log::RemoteCall, shared->call_type, shared->heap_used);
+				
 				if(shared->error_type == Error::Unknown)
 					shared->error_type = Error::None;
 					
-				__sync_synchronize();
-				
-				SetEvent(shared->event_start);
+				signal_start();
 			}
 			
 			exit_loop:;
@@ -93,6 +189,7 @@ namespace Shade
 				return GetLastError();
 			
 			heap.setup((void *)(shared + 1), Shared::mapping_size - sizeof(Shared));
+			heap.exhausted = out_of_memory;
 			
 			HMODULE d3d9 = LoadLibrary("d3d9.dll");
 
@@ -106,6 +203,11 @@ namespace Shade
 			
 			ctors();
 			
+			init_ui_types();
+			
+			if(!Workers::init())
+				return GetLastError();
+			
 			return ERROR_SUCCESS;
 		}
 	};
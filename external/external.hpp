@@ -14,6 +14,7 @@ namespace Shade
 	namespace Remote
 	{
 		void set_error(Error::Type error);
+		void out_of_memory();
 		size_t init();
 	};
 };
@@ -5,20 +5,20 @@ namespace Shade
 {
 	Heap heap;
 
-	void *Heap::allocate(size_t bytes)
+	void *Heap::allocate(size_t bytes, size_t alignment)
 	{
-		char *result = current;
+		char *old, *result, *next;
 
-		char *next = result + bytes;
-
-		if(next > max)
+		do
 		{
-			shared->error_type = Error::OutOfMemory;
-			SetEvent(shared->event_start);
-			Sleep(INFINITE);
-		}
+			old = current;
+			result = (char *)(((size_t)old + alignment - 1) & ~(alignment - 1));
+			next = result + bytes;
 
-		current = next;
+			if(next > max)
+				exhausted();
+		}
+		while(InterlockedCompareExchangePointer((void *volatile *)&current, next, old) != old);
 
 		return (void *)result;
 	}
@@ -5,15 +5,21 @@ namespace Shade
 {
 	class Heap
 	{
-		char *current;
+		char *volatile current; // Advanced with a compare and swap, since remote workers allocate concurrently
 		char *max;
 
 	public:
 		size_t start;
+		void (*exhausted)(); // Called when an allocation doesn't fit, set by the remote init. It doesn't return.
 	
-		void *allocate(size_t bytes);
+		void *allocate(size_t bytes, size_t alignment = 1);
 		void setup(void *start, size_t size);
 		void reset();
+		
+		size_t used()
+		{
+			return (size_t)current - start;
+		}
 	};
 
 	class HeapObject
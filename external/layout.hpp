@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+	Field offsets and structure sizes which change between game builds.
+	The values here are the defaults for 1.0.3.10235 and are checked against the D3 structures in verify_offsets.
+	A layout profile (layout.txt) loaded by the host can override them. Remote code refers to them through
+	the layout_<struct>_<field> and layout_<struct>_size globals which compile_module replaces with
+	constants before code generation, so there is no runtime indirection.
+*/
+#define SHADE_LAYOUT(field, size) \
+	field(ObjectList, type, 0x0) \
+	field(ObjectList, slot_size, 0x100) \
+	field(ObjectList, total_count, 0x108) \
+	field(ObjectList, slots, 0x148) \
+	field(GameData, object_lists, 0x390) \
+	field(ObjectListNode, value, 0x0) \
+	field(ObjectListNode, next, 0x8) \
+	field(Actor, id, 0x0) \
+	field(Actor, common_data_id, 0x4) \
+	field(Actor, name, 0x8) \
+	field(Actor, world_id, 0xD8) \
+	field(Actor, movement, 0x380) \
+	size(Actor, 0x428) \
+	field(ActorMovement, current_speed, 0xC) \
+	field(ActorMovement, moving_to, 0x3C) \
+	field(ActorMovement, position_0, 0x4C) \
+	field(ActorMovement, actor_id, 0x15C) \
+	field(ActorMovement, frame, 0x160) \
+	field(ActorMovement, direction, 0x170) \
+	field(ActorCommonData, id, 0x0) \
+	field(ActorCommonData, name, 0x4) \
+	field(ActorCommonData, owner_id, 0x110) \
+	size(ActorCommonData, 0x2D0) \
+	field(UIComponent, v_table, 0x0) \
+	field(UIComponent, visible, 0x28) \
+	field(UIComponent, self, 0x30) \
+	field(UIContainer, children, 0x460) \
+	field(UIContainer, child_count, 0x468) \
+	field(UIControl, text, 0xAC8) \
+	field(UIHandler, name, 0x0) \
+	field(UIHandler, hash, 0x4) \
+	field(UIHandler, execute, 0x8) \
+	field(ObjectManager, scences, 0x8F4) \
+	field(ObjectManager, ui_manager, 0x924) \
+	field(UIManager, component_map, 0x0) \
+	field(UIComponentMap, table, 0x8) \
+	field(UIComponentMap, mask, 0x40) \
+	field(UIComponentPair, next, 0x0) \
+	field(UIComponentPair, key, 0x8) \
+	field(UIComponentPair, value, 0x210) \
+	field(Scene, sno_id, 0x4) \
+	field(Scene, world_id, 0x8) \
+	field(Scene, min, 0xE0) \
+	field(Scene, max, 0xE8) \
+	field(Scene, cells, 0x180) \
+	field(Scene, cell_count, 0x184) \
+	size(Scene, 0x2A8) \
+	field(NavCell, min, 0x0) \
+	field(NavCell, max, 0xC) \
+	field(NavCell, flags, 0x18) \
+	size(NavCell, 0x20)
@@ -0,0 +1,46 @@
+#include "log.hpp"
+#include "shared.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		void log(Log::Id id, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+		{
+			auto ring = &shared->log;
+			
+			long position;
+			
+			while(true)
+			{
+				position = ring->head;
+				
+				if((size_t)(position - ring->tail) >= LogRing::capacity)
+				{
+					__sync_fetch_and_add(&ring->dropped, 1);
+					return;
+				}
+				
+				if(__sync_val_compare_and_swap(&ring->head, position, position + 1) == position)
+					break;
+			}
+			
+			auto &record = ring->records[position & (LogRing::capacity - 1)];
+			
+			LARGE_INTEGER time;
+			
+			QueryPerformanceCounter(&time);
+			
+			record.id = id;
+			record.time = time.QuadPart;
+			record.args[0] = arg0;
+			record.args[1] = arg1;
+			record.args[2] = arg2;
+			record.args[3] = arg3;
+			
+			__sync_synchronize();
+			
+			record.sequence = position + 1;
+		}
+	};
+};
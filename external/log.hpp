@@ -0,0 +1,52 @@
+#pragma once
+#include "external.hpp"
+
+namespace Shade
+{
+	namespace Log
+	{
+		// The format strings are in log.cpp on the host
+		enum Id
+		{
+			RemoteCall, // Call type, heap bytes used
+			RemoteCallTime, // Call type, microseconds on the host
+			UIListed, // Elements, visible controls
+			Listing, // Call type
+			ActorsGrouped, // Selected actors, actors, worlds, nanoseconds
+			ModulesRan, // Modules, waves, actions, microseconds
+			Count
+		};
+		
+		static const size_t max_args = 4;
+	};
+	
+	struct LogRecord
+	{
+		volatile long sequence; // Set to the reserved position + 1 once the record is written
+		uint32_t id;
+		uint64_t time; // QueryPerformanceCounter, which is the same in both processes
+		uint32_t args[Log::max_args];
+	};
+	
+	/*
+		Bounded multiple producer, single consumer ring of log records in the shared mapping. Writers reserve
+		a position by advancing 'head' with a compare and swap, fill in the record and publish it by setting its
+		sequence. Writers never wait. If the ring is full the record is counted in 'dropped' instead.
+		The host drains the ring from a background thread and formats the records.
+	*/
+	struct LogRing
+	{
+		static const size_t capacity = 0x400; // Must be a power of 2
+		
+		volatile long head;
+		volatile long tail;
+		volatile long dropped;
+		
+		LogRecord records[capacity];
+	};
+	
+	namespace Remote
+	{
+		void log(Log::Id id, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0);
+	};
+};
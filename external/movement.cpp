@@ -0,0 +1,31 @@
+#include "movement.hpp"
+#include "shared.hpp"
+#include "d3.hpp"
+#include "copy.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		SHADE_COLUMNS_COPY(Movement, ActorMovement, SHADE_SCHEMA_MOVEMENT)
+		
+		void list_movement()
+		{
+			auto movement = new Movement;
+			
+			auto list = (*D3::game_data)->get_object_list("RActors");
+			
+			// The number of actors is an upper bound for the number of rows
+			movement->allocate(d3_field(list, ObjectList, total_count));
+			
+			list->each_object<D3::Actor>([&](D3::Actor *d3_actor) {
+				auto d3_movement = d3_field(d3_actor, Actor, movement);
+				
+				if(d3_movement)
+					append(movement, d3_movement);
+			});
+			
+			shared->data.movement = movement;
+		}
+	};
+};
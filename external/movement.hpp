@@ -0,0 +1,32 @@
+#pragma once
+#include "schema.hpp"
+
+#define SHADE_SCHEMA_MOVEMENT(self, value, string, text) \
+	value(ActorMovement, size_t, actor_id, actor_id) \
+	value(ActorMovement, size_t, frame, frame) \
+	value(ActorMovement, float, speed, current_speed) \
+	value(ActorMovement, float, direction, direction) \
+	value(ActorMovement, Remote::Vector3, position, position_0) \
+	value(ActorMovement, Remote::Vector3, moving_to, moving_to)
+
+namespace Shade
+{
+	namespace Remote
+	{
+		struct Vector3
+		{
+			float x;
+			float y;
+			float z;
+			
+			Vector3() {}
+			
+			// Converts from D3::Vector<3>, which is only visible to remote code
+			template<class V> explicit Vector3(const V &vector) : x(vector.array[0]), y(vector.array[1]), z(vector.array[2]) {}
+		};
+		
+		SHADE_COLUMNS(Movement, SHADE_SCHEMA_MOVEMENT)
+		
+		void list_movement();
+	};
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "utils.hpp"
+
+/*
+	Generator for records copied from game structures into the shared heap.
+
+	A schema is a macro taking the generator macros (self, value, string, text) and listing the fields of a record:
+		self(name) - Pointer to the game structure
+		value(source, type, name, field) - Copy of a field listed in layout.hpp
+		string(source, name, field) - Fixed size character array listed in layout.hpp, copied into a String
+		text(source, name, field) - Zero terminated string pointer listed in layout.hpp, copied into a String if it's not null
+
+	From a schema this generates:
+		SHADE_ROW - A record type linked into a List
+		SHADE_COLUMNS - A columnar type with one array per field
+		SHADE_ROW_COPY / SHADE_COLUMNS_COPY - The remote copy routines, defined in copy.hpp
+		SHADE_ROW_DESCRIBE - A host routine writing a record to a stream
+*/
+
+#define SHADE_SCHEMA_ROW_SELF(name) void *name;
+#define SHADE_SCHEMA_ROW_VALUE(source, type, name, field) type name;
+#define SHADE_SCHEMA_ROW_STRING(source, name, field) Ptr<String> name;
+
+#define SHADE_ROW(record, schema) \
+	struct record: \
+		public HeapObject \
+	{ \
+		schema(SHADE_SCHEMA_ROW_SELF, SHADE_SCHEMA_ROW_VALUE, SHADE_SCHEMA_ROW_STRING, SHADE_SCHEMA_ROW_STRING) \
+		Ptr<record> next; \
+	};
+
+/*
+	Columns are allocated with 16 byte alignment so they can be processed with SIMD.
+	'count' is the number of records, 'capacity' the number of entries allocated in each column.
+*/
+#define SHADE_SCHEMA_COLUMN_SELF(name) Ptr<void *> name;
+#define SHADE_SCHEMA_COLUMN_VALUE(source, type, name, field) Ptr<type> name;
+#define SHADE_SCHEMA_COLUMN_STRING(source, name, field) Ptr<Ptr<String>> name;
+
+#define SHADE_SCHEMA_ALLOCATE_SELF(name) name = (void **)heap.allocate(capacity * sizeof(void *), 16);
+#define SHADE_SCHEMA_ALLOCATE_VALUE(source, type, name, field) name = (type *)heap.allocate(capacity * sizeof(type), 16);
+#define SHADE_SCHEMA_ALLOCATE_STRING(source, name, field) name = (Ptr<String> *)heap.allocate(capacity * sizeof(Ptr<String>), 16);
+
+#define SHADE_COLUMNS(columns, schema) \
+	struct columns: \
+		public HeapObject \
+	{ \
+		size_t count; \
+		size_t capacity; \
+		schema(SHADE_SCHEMA_COLUMN_SELF, SHADE_SCHEMA_COLUMN_VALUE, SHADE_SCHEMA_COLUMN_STRING, SHADE_SCHEMA_COLUMN_STRING) \
+		\
+		void allocate(size_t capacity) \
+		{ \
+			this->count = 0; \
+			this->capacity = capacity; \
+			schema(SHADE_SCHEMA_ALLOCATE_SELF, SHADE_SCHEMA_ALLOCATE_VALUE, SHADE_SCHEMA_ALLOCATE_STRING, SHADE_SCHEMA_ALLOCATE_STRING) \
+		} \
+	};
+
+#define SHADE_SCHEMA_DESCRIBE_SELF(name) out << "\n\t " #name ": " << record.name;
+#define SHADE_SCHEMA_DESCRIBE_VALUE(source, type, name, field) out << "\n\t " #name ": " << record.name;
+#define SHADE_SCHEMA_DESCRIBE_STRING(source, name, field) if(record.name) out << "\n\t " #name ": " << record.name->c_str();
+
+#define SHADE_ROW_DESCRIBE(record_type, schema) \
+	template<class S> void describe(S &out, Remote::record_type &record) \
+	{ \
+		out << #record_type; \
+		schema(SHADE_SCHEMA_DESCRIBE_SELF, SHADE_SCHEMA_DESCRIBE_VALUE, SHADE_SCHEMA_DESCRIBE_STRING, SHADE_SCHEMA_DESCRIBE_STRING) \
+		out << "\n"; \
+	}
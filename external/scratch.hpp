@@ -0,0 +1,41 @@
+#pragma once
+#include "shared.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		/*
+			Growable array in the process heap for temporary data which shouldn't take up space in the shared heap.
+			The memory is kept between calls. Global initializers in the remote code can't hold pointers, so the members
+			are left without initializers and a zeroed global is an empty array.
+		*/
+		template<class T> struct ScratchArray
+		{
+			T *data;
+			size_t size;
+			size_t capacity;
+			
+			void push(const T &value)
+			{
+				if(size == capacity)
+				{
+					capacity = capacity ? capacity * 2 : 0x100;
+					
+					data = (T *)(data ? HeapReAlloc(GetProcessHeap(), 0, data, capacity * sizeof(T)) : HeapAlloc(GetProcessHeap(), 0, capacity * sizeof(T)));
+					
+					// Handled like running out of space in the shared heap
+					if(!data)
+						out_of_memory();
+				}
+				
+				data[size++] = value;
+			}
+			
+			T &pop()
+			{
+				return data[--size];
+			}
+		};
+	};
+};
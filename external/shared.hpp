@@ -1,7 +1,10 @@
 #pragma once
 #include "heap.hpp"
+#include "log.hpp"
 #include "ui.hpp"
 #include "assets.hpp"
+#include "world.hpp"
+#include "movement.hpp"
 
 namespace Shade
 {
@@ -14,6 +17,10 @@ namespace Shade
 			ListUIHandlers,
 			ListCommonDataAssets,
 			ListRActorAssets,
+			Snapshot, // Lists the UI, actors and ACDs in a single call, since each call resets the heap
+			ExtractWorld,
+			ListMovement,
+			RegisterUIType, // Registers Shared::ui_type
 			Dummy
 		};
 	};
@@ -29,9 +36,48 @@ namespace Shade
 		};
 	};
 
+	namespace Symbol
+	{
+		/*
+			Addresses in the symbol table are virtual addresses relative to this image base,
+			so they match the addresses found in a disassembly of the 1.0.3.10235 executable.
+		*/
+		const size_t image_base = 0x800000;
+
+		enum Type
+		{
+			UIReferenceList,
+			AttributeList,
+			UIHandlerList,
+			ObjectManager,
+			WindowNotMinimized,
+			GameData,
+			IterateActorObjects,
+			GetUIComponent,
+			ExtractUIRect,
+			MapUIRect,
+			Count
+		};
+	};
+
+	/*
+		One direction of the remote_call handshake. The signaling side increments 'sequence'.
+		The waiting side spins on 'sequence' for an adaptive number of iterations before it sets 'parked'
+		and blocks on the event. The event is only signaled if the waiting side is parked.
+	*/
+	struct Handshake
+	{
+		static const size_t spin_min = 0x40;
+		static const size_t spin_max = 0x10000;
+
+		volatile long sequence;
+		volatile long parked;
+	};
+
 	struct Shared
 	{
 		static const size_t mapping_size = 0x2000000;
+		static const size_t max_workers = 8;
 		
 		volatile Call::Type call_type;
 		volatile Error::Type error_type;
@@ -40,15 +86,39 @@ namespace Shade
 		HANDLE event_end;
 		HANDLE event_thread; // Must follow event_end
 		
+		Handshake handshake_start; // Signaled by the remote tick
+		Handshake handshake_end; // Signaled by the host
+		
 		size_t d3d_present_offset;
 		void *d3d_present;
+		size_t symbols[Symbol::Count]; // Filled in by the host before init runs
+		size_t workers; // Number of remote worker threads, set by the host before init runs
 		bool triggered;
+		size_t heap_used; // Bytes allocated from the heap by the last call
+		/*
+			Predicates compiled by the host (see compiler/filter.cpp). Objects are only listed if the
+			predicate for their type returns nonzero or if there is no predicate.
+		*/
+		struct {
+			int (*actor)(void *object);
+			int (*acd)(void *object);
+		} filters;
+		
+		struct {
+			size_t v_table;
+			size_t kind; // Remote::UIType::Kind
+		} ui_type;
+		
+		LogRing log;
+		
 		struct {
 			Ptr<Remote::UIElement> ui_root;
 			Ptr<List<Remote::UIHandler>> ui_handlers;
 			Ptr<List<Remote::Actor>> actors;
 			Ptr<List<Remote::ActorCommonData>> acds;
-			size_t num;
+			Ptr<List<Remote::SceneGeometry>> scenes;
+			Ptr<Remote::Movement> movement;
+			size_t num; // Argument for calls which take one
 			void *ptr;
 		} data;
 	};
@@ -0,0 +1,133 @@
+#include "ui-types.hpp"
+#include "shared.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		UITypeRegistry ui_types;
+		
+		void container_children(D3::UIComponent *component, D3::UIComponent **&list, size_t &count)
+		{
+			auto container = (D3::UIContainer *)component;
+			
+			count = d3_field(container, UIContainer, child_count);
+			list = d3_field(container, UIContainer, children);
+		}
+		
+		void extract_control(UIElement *element, D3::UIComponent *component)
+		{
+			auto control = (D3::UIControl *)component;
+			
+			auto text = d3_field(control, UIControl, text);
+			
+			if(text)
+				element->text = new String(text);
+			
+			auto rect = new UIRect;
+			
+			D3::UIRect d3_rect;
+			
+			D3::extract_ui_rect(control, &d3_rect);
+			D3::map_ui_rect(&d3_rect, &d3_rect, true, true);
+			
+			rect->left = d3_rect.left;
+			rect->top = d3_rect.top;
+			rect->right = d3_rect.right;
+			rect->bottom = d3_rect.bottom;
+			
+			element->rect = rect;
+		}
+		
+		// Finds a multiplier which maps every key to a different slot of the smallest table possible
+		bool rebuild()
+		{
+			size_t bits = 1;
+			
+			while(((size_t)1 << bits) < ui_types.count * 2)
+				bits++;
+			
+			for(; bits <= UITypeRegistry::max_bits; ++bits)
+			{
+				size_t shift = 32 - bits;
+				
+				for(uint32_t attempt = 0; attempt < 0x100; ++attempt)
+				{
+					uint32_t multiplier = 0x9E3779B1 + attempt * 2;
+					
+					__builtin_memset(ui_types.table, 0, sizeof(ui_types.table));
+					
+					size_t i = 0;
+					
+					for(; i < ui_types.count; ++i)
+					{
+						auto &entry = ui_types.table[(uint32_t)(ui_types.keys[i].v_table * multiplier) >> shift];
+						
+						if(entry.type)
+							break;
+						
+						entry = ui_types.keys[i];
+					}
+					
+					if(i == ui_types.count)
+					{
+						ui_types.multiplier = multiplier;
+						ui_types.shift = shift;
+						return true;
+					}
+				}
+			}
+			
+			return false;
+		}
+		
+		bool register_ui_type(size_t v_table, UIType::Kind kind)
+		{
+			if(kind >= UIType::KindCount)
+				return false;
+			
+			v_table += D3::diablo_exe.delta;
+			
+			for(size_t i = 0; i < ui_types.count; ++i)
+			{
+				if(ui_types.keys[i].v_table == v_table)
+				{
+					ui_types.keys[i].type = &ui_types.types[kind];
+					return rebuild();
+				}
+			}
+			
+			if(ui_types.count == UITypeRegistry::max_types)
+				return false;
+			
+			UITypeRegistry::Entry entry = {v_table, &ui_types.types[kind]};
+			
+			ui_types.keys[ui_types.count++] = entry;
+			
+			if(rebuild())
+				return true;
+			
+			ui_types.count--;
+			rebuild();
+			
+			return false;
+		}
+		
+		void init_ui_types()
+		{
+			ui_types.types[UIType::Container].children = container_children;
+			ui_types.types[UIType::Control].children = container_children;
+			ui_types.types[UIType::Control].extract = extract_control;
+			
+			ui_types.shift = 31;
+			
+			register_ui_type(0x13E25B8, UIType::Control); // UIButton
+			register_ui_type(0x13A2760, UIType::Control); // UILabel
+			register_ui_type(0x13D4EB8, UIType::Control); // UIEdit
+			
+			register_ui_type(0x13ED3D8, UIType::Leaf); // UIShortcut
+			register_ui_type(0x13ED258, UIType::Leaf); // UIDrawHook
+			register_ui_type(0x13D7478, UIType::Leaf); // UIEvent
+		}
+	};
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include "ui.hpp"
+#include "d3.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		/*
+			Describes how a kind of UIComponent is copied. Components are classified by their virtual table.
+		*/
+		struct UIType
+		{
+			enum Kind
+			{
+				Leaf, // No children and nothing to extract
+				Container, // Children are copied
+				Control, // Children are copied and text and rectangles are extracted when visible
+				KindCount
+			};
+			
+			// Returns the children of the component. 0 for components without children.
+			void (*children)(D3::UIComponent *component, D3::UIComponent **&list, size_t &count);
+			
+			// Extracts data for visible components after the tree is built. May be 0.
+			void (*extract)(UIElement *element, D3::UIComponent *component);
+		};
+		
+		/*
+			Maps relocated virtual tables to types with a perfect hash, so classification is a single probe.
+			The hash is rebuilt when a type is registered. Global initializers in the remote code can't hold pointers,
+			so the registry is a zeroed global and init_ui_types fills in the descriptors.
+		*/
+		struct UITypeRegistry
+		{
+			static const size_t max_types = 0x40;
+			static const size_t max_bits = 8;
+			
+			struct Entry
+			{
+				size_t v_table;
+				UIType *type;
+			};
+			
+			uint32_t multiplier;
+			size_t shift;
+			Entry table[1 << max_bits];
+			
+			Entry keys[max_types];
+			size_t count;
+			
+			UIType types[UIType::KindCount];
+			
+			__attribute__((always_inline)) UIType *find(D3::UIComponent *component)
+			{
+				size_t v_table = (size_t)d3_field(component, UIComponent, v_table);
+				
+				Entry &entry = table[(uint32_t)(v_table * multiplier) >> shift];
+				
+				// Unknown components are treated as containers
+				return entry.v_table == v_table ? entry.type : &types[UIType::Container];
+			}
+		};
+		
+		extern UITypeRegistry ui_types;
+		
+		void init_ui_types();
+		
+		/*
+			Registers a virtual table at an address in the 1.0.3.10235 executable, which is relocated to the loaded module.
+			Returns false if the table is full or no perfect hash was found.
+		*/
+		bool register_ui_type(size_t v_table, UIType::Kind kind);
+	};
+};
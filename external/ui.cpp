@@ -1,90 +1,112 @@
 #include "ui.hpp"
 #include "shared.hpp"
 #include "d3.hpp"
+#include "copy.hpp"
+#include "ui-types.hpp"
+#include "scratch.hpp"
 
 namespace Shade
 {
 	namespace Remote
 	{
-		void do_control(UIElement *element, D3::UIComponent *component)
+		struct PendingElement
 		{
-			switch((size_t)component->v_table)
-			{
-				case 0x13E25B8:
-				case 0x13A2760:
-				case 0x13D4EB8:
-					break;
-					
-				default:
-					return;
-			}
-			
-			auto control = (D3::UIControl *)component;
-			
-			if(control->text)
-				element->text = new String(control->text);
+			D3::UIComponent *component;
+			UIElement *element;
+		};
+		
+		static ScratchArray<PendingElement> stack;
+		static ScratchArray<PendingElement> controls;
+		
+		SHADE_ROW_COPY(UIHandler, UIHandler, SHADE_SCHEMA_UI_HANDLER)
+		
+		void copy_element(UIElement *element, D3::UIComponent *component)
+		{
+			auto &self = d3_field(component, UIComponent, self);
 			
-			auto rect = new UIRect;
+			element->ptr = component;
+			element->name = new String(self.name, sizeof(D3::UIReference::name));
 			
-			D3::UIRect d3_rect;
+			element->visible = d3_field(component, UIComponent, visible) != 0;
+			element->hash = self.hash;
 			
-			D3::extract_ui_rect(control, &d3_rect);
-			D3::map_ui_rect(&d3_rect, &d3_rect, true, true);
+			element->v_table = d3_field(component, UIComponent, v_table);
 			
-			rect->left = d3_rect.left;
-			rect->top = d3_rect.top;
-			rect->right = d3_rect.right;
-			rect->bottom = d3_rect.bottom;
+			auto type = ui_types.find(component);
 			
-			element->rect = rect;
-		}
-		
-		UIElement *copy_element(D3::UIComponent *component);
-		
-		void do_container(UIElement *element, D3::UIComponent *component)
-		{
-			switch((size_t)component->v_table)
+			// Text and rectangles are only extracted for visible controls, after the tree is built
+			if(element->visible && type->extract)
 			{
-				case 0x13ED3D8:
-				case 0x13ED258:
-				case 0x13D7478:
-					return;
-					
-				default:
-					break;
+				PendingElement control = {component, element};
+				
+				controls.push(control);
 			}
-		
-			auto container = (D3::UIContainer *)component;
-			
-			element->children.allocate(container->child_count);
 			
-			for(size_t i = 0; i < container->child_count; ++i)
-				element->children[i] = copy_element(container->children[i]);
-		}
-		
-		UIElement *copy_element(D3::UIComponent *component)
-		{
-			auto element = new UIElement;
-			
-			element->ptr = component;
-			element->name = new String(component->self.name, sizeof(D3::UIReference::name));
+			if(!type->children)
+				return;
 			
-			element->visible = component->visible != 0;
-			element->hash = component->self.hash;
+			size_t count;
+			D3::UIComponent **children;
 			
-			element->v_table = component->v_table;
+			type->children(component, children, count);
 			
-			do_control(element, component);
-			do_container(element, component);
+			element->children.allocate(count);
 			
-			return element;
+			// Pushed in reverse so the children are visited in order
+			for(size_t i = count; i-- > 0;)
+			{
+				auto child = new UIElement;
+				
+				element->children[i] = child;
+				
+				PendingElement pending = {children[i], child};
+				
+				stack.push(pending);
+			}
 		}
 		
+		/*
+			The tree is walked with an explicit stack. The first phase only reads the UIComponent headers
+			and builds the elements, prefetching the component which is visited next. The second phase reads
+			the text and rectangles of the visible controls, which are large and need calls into the game.
+		*/
 		void list_ui()
 		{
 			auto d3_root = D3::get_ui_component(&D3::ui_reference_list[D3::UIReferenceList_Root]);
 			
-			shared->data.ui_root = copy_element(d3_root);
+			auto root = new UIElement;
+			
+			stack.size = 0;
+			controls.size = 0;
+			
+			PendingElement first = {d3_root, root};
+			
+			stack.push(first);
+			
+			size_t elements = 0;
+			
+			while(stack.size)
+			{
+				PendingElement current = stack.pop();
+				
+				elements++;
+				
+				if(stack.size)
+					__builtin_prefetch(stack.data[stack.size - 1].component);
+				
+				copy_element(current.element, current.component);
+			}
+			
+			for(size_t i = 0; i < controls.size; ++i)
+			{
+				auto &control = controls.data[i];
+				
+				ui_types.find(control.component)->extract(control.element, control.component);
+			}
+			
+			shared->data.ui_root = root;
+			
+			log(Log::UIListed, elements, controls.size);
 		}
 		
 		void list_ui_handlers()
@@ -95,14 +117,12 @@ namespace Shade
 			{
 				auto d3_handler = &D3::ui_handler_list[i];
 				
-				if(!d3_handler->name)
+				if(!d3_field(d3_handler, UIHandler, name))
 					continue;
 				
 				auto handler = new UIHandler;
 				
-				handler->func = d3_handler->execute;
-				handler->hash = d3_handler->hash;
-				handler->name = new String(d3_handler->name);
+				copy(handler, d3_handler);
 				
 				handlers->append(handler);
 			}
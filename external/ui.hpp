@@ -1,5 +1,10 @@
 #pragma once
-#include "utils.hpp"
+#include "schema.hpp"
+
+#define SHADE_SCHEMA_UI_HANDLER(self, value, string, text) \
+	text(UIHandler, name, name) \
+	value(UIHandler, void *, func, execute) \
+	value(UIHandler, uint32_t, hash, hash)
 
 namespace Shade
 {
@@ -28,15 +33,7 @@ namespace Shade
 			Vector<Ptr<UIElement>> children;
 		};
 		
-		struct UIHandler:
-			public HeapObject
-		{
-			Ptr<UIHandler> next;
-			
-			Ptr<String> name;
-			void *func;
-			uint32_t hash;
-		};
+		SHADE_ROW(UIHandler, SHADE_SCHEMA_UI_HANDLER)
 		
 		void list_ui();
 		void list_ui_handlers();
@@ -0,0 +1,130 @@
+#include "workers.hpp"
+#include "shared.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		namespace Workers
+		{
+			/*
+				Each job releases one permit of the semaphore per worker. A worker takes indices until they run out
+				and then leaves the job, and the last one to leave signals 'done'. The caller waits for that, so
+				no worker still reads the job when the next one is set up.
+			*/
+			HANDLE semaphore;
+			HANDLE done;
+			size_t count;
+			DWORD threads[Shared::max_workers];
+			
+			struct Job
+			{
+				func_t func;
+				void *arg;
+				size_t count;
+				volatile long next;
+				volatile long active;
+			};
+			
+			Job job;
+			
+			void work()
+			{
+				while(true)
+				{
+					size_t index = __sync_fetch_and_add(&job.next, 1);
+					
+					if(index >= job.count)
+						break;
+					
+					job.func(index, job.arg);
+				}
+			}
+			
+			DWORD WINAPI worker(void *)
+			{
+				while(true)
+				{
+					WaitForSingleObject(semaphore, INFINITE);
+					
+					work();
+					
+					if(__sync_sub_and_fetch(&job.active, 1) == 0)
+						SetEvent(done);
+				}
+			}
+			
+			bool init()
+			{
+				if(!shared->workers)
+					return true;
+				
+				semaphore = CreateSemaphore(0, 0, Shared::max_workers, 0);
+				done = CreateEvent(0, FALSE, FALSE, 0);
+				
+				if(!semaphore || !done)
+					return false;
+				
+				for(; count < shared->workers && count < Shared::max_workers; ++count)
+				{
+					HANDLE thread = CreateThread(0, 0, worker, 0, 0, &threads[count]);
+					
+					if(!thread)
+						break;
+					
+					CloseHandle(thread);
+				}
+				
+				return count != 0;
+			}
+			
+			void run(size_t count, func_t func, void *arg)
+			{
+				job.func = func;
+				job.arg = arg;
+				job.count = count;
+				job.next = 0;
+				
+				// A single item isn't worth waking the workers for
+				if(!Workers::count || count < 2)
+				{
+					work();
+					return;
+				}
+				
+				job.active = Workers::count;
+				
+				__sync_synchronize();
+				
+				ReleaseSemaphore(semaphore, Workers::count, 0);
+				
+				work();
+				
+				WaitForSingleObject(done, INFINITE);
+				
+				if(shared->error_type == Error::OutOfMemory)
+					out_of_memory();
+			}
+			
+			bool leave()
+			{
+				DWORD self = GetCurrentThreadId();
+				
+				for(size_t i = 0; i < count; ++i)
+				{
+					if(threads[i] != self)
+						continue;
+					
+					__sync_lock_test_and_set(&job.next, job.count);
+					
+					if(__sync_sub_and_fetch(&job.active, 1) == 0)
+						SetEvent(done);
+					
+					return true;
+				}
+				
+				return false;
+			}
+		};
+	};
+};
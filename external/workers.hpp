@@ -0,0 +1,37 @@
+#pragma once
+#include "external.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		/*
+			Pool of threads in the game process which post-processing can run on while the render thread
+			waits in a remote call. The number of threads is set by the host in Shared::workers.
+			Without workers, jobs run on the calling thread.
+		*/
+		namespace Workers
+		{
+			typedef void (*func_t)(size_t index, void *arg);
+			
+			// Starts the worker threads. Returns false if they couldn't be created.
+			bool init();
+			
+			// Calls 'func' once for each index below 'count' on the workers and the calling thread. Returns when all calls are done.
+			void run(size_t count, func_t func, void *arg);
+			
+			/*
+				Called on a failing thread. If it's a worker, the rest of the job is skipped and the worker leaves it,
+				so run returns and reports the error on the calling thread. Returns false on other threads.
+			*/
+			bool leave();
+			
+			template<typename F> void run(size_t count, F &func)
+			{
+				run(count, [](size_t index, void *arg) {
+					(*(F *)arg)(index);
+				}, (void *)&func);
+			}
+		};
+	};
+};
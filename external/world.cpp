@@ -0,0 +1,102 @@
+#include "world.hpp"
+#include "shared.hpp"
+#include "d3.hpp"
+#include "scratch.hpp"
+#include "workers.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		void copy_scene(SceneGeometry *scene, D3::Scene *d3_scene)
+		{
+			auto &min = d3_field(d3_scene, Scene, min);
+			auto &max = d3_field(d3_scene, Scene, max);
+			
+			scene->id = d3_scene->id;
+			scene->min_x = min.array[0];
+			scene->min_y = min.array[1];
+			scene->max_x = max.array[0];
+			scene->max_y = max.array[1];
+			
+			size_t count = d3_field(d3_scene, Scene, cell_count);
+			auto cells = (char *)d3_field(d3_scene, Scene, cells);
+			
+			size_t walkable = 0;
+			
+			for(size_t i = 0; i < count; ++i)
+			{
+				auto cell = (D3::NavCell *)(cells + i * D3::Size<D3::NavCell>::get());
+				
+				if(d3_field(cell, NavCell, flags) & D3::NavCell::AllowWalk)
+					walkable++;
+			}
+			
+			scene->cells.allocate(walkable);
+			
+			auto out = scene->cells.begin();
+			
+			// Cells are stored relative to the scene
+			for(size_t i = 0; i < count; ++i)
+			{
+				auto cell = (D3::NavCell *)(cells + i * D3::Size<D3::NavCell>::get());
+				
+				size_t flags = d3_field(cell, NavCell, flags);
+				
+				if(!(flags & D3::NavCell::AllowWalk))
+					continue;
+				
+				auto &cell_min = d3_field(cell, NavCell, min);
+				auto &cell_max = d3_field(cell, NavCell, max);
+				
+				out->min_x = scene->min_x + cell_min.array[0];
+				out->min_y = scene->min_y + cell_min.array[1];
+				out->max_x = scene->min_x + cell_max.array[0];
+				out->max_y = scene->min_y + cell_max.array[1];
+				out->flags = flags;
+				
+				out++;
+			}
+		}
+		
+		struct PendingScene
+		{
+			D3::Scene *d3_scene;
+			SceneGeometry *scene;
+		};
+		
+		static ScratchArray<PendingScene> pending;
+		
+		/*
+			The render thread only collects the scenes of the world, so the list keeps the order of the game.
+			The cells, which make up most of the work, are copied on the remote workers.
+		*/
+		void extract_world()
+		{
+			auto scenes = new List<SceneGeometry>;
+			
+			auto list = d3_field(*D3::object_manager, ObjectManager, scences);
+			
+			pending.size = 0;
+			
+			list->each_object<D3::Scene>([&](D3::Scene *d3_scene) {
+				if((size_t)d3_field(d3_scene, Scene, world_id) != shared->data.num)
+					return;
+				
+				PendingScene entry = {d3_scene, new SceneGeometry};
+				
+				scenes->append(entry.scene);
+				
+				pending.push(entry);
+			});
+			
+			auto func = [](size_t index) {
+				copy_scene(pending.data[index].scene, pending.data[index].d3_scene);
+			};
+			
+			Workers::run(pending.size, func);
+			
+			shared->data.scenes = scenes;
+		}
+	};
+};
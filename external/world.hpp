@@ -0,0 +1,33 @@
+#pragma once
+#include "utils.hpp"
+
+namespace Shade
+{
+	namespace Remote
+	{
+		// Walkable navigation cell in world coordinates
+		struct WorldCell
+		{
+			float min_x;
+			float min_y;
+			float max_x;
+			float max_y;
+			uint32_t flags;
+		};
+		
+		struct SceneGeometry:
+			public HeapObject
+		{
+			size_t id;
+			float min_x;
+			float min_y;
+			float max_x;
+			float max_y;
+			Vector<WorldCell> cells;
+			Ptr<SceneGeometry> next;
+		};
+		
+		// Lists the scenes of the world with the id in Shared::data.num
+		void extract_world();
+	};
+};
@@ -0,0 +1,155 @@
+#include "log.hpp"
+#include <cstdio>
+
+using namespace Shade;
+
+static const char *formats[Log::Count] = {
+	"Remote call %u used %u bytes of heap",
+	"Remote call %u took %u us",
+	"Listed %u UI elements with %u visible controls",
+	"Listing with remote call %u",
+	"Grouped %u of %u actors into %u worlds in %u ns",
+	"Ran %u modules in %u waves with %u actions in %u us"
+};
+
+static FILE *file;
+static LogRing *ring; // Kept while a replay points 'shared' at its own buffer
+static HANDLE thread_handle;
+static volatile bool running;
+static LARGE_INTEGER frequency;
+static LARGE_INTEGER start_time;
+static long dropped_reported;
+
+static void drain()
+{
+	while(true)
+	{
+		long position = ring->tail;
+
+		auto &record = ring->records[position & (LogRing::capacity - 1)];
+
+		if(record.sequence != position + 1)
+			break;
+
+		MemoryBarrier();
+
+		double ms = (double)((int64_t)record.time - start_time.QuadPart) * 1000.0 / frequency.QuadPart;
+
+		fprintf(file, "%10.3f ", ms);
+
+		if(record.id < Log::Count)
+			fprintf(file, formats[record.id], record.args[0], record.args[1], record.args[2], record.args[3]);
+		else
+			fprintf(file, "Unknown record %u", record.id);
+
+		fputc('\n', file);
+
+		MemoryBarrier();
+
+		// The slot can be reused once the tail is past it
+		ring->tail = position + 1;
+	}
+
+	long dropped = ring->dropped;
+
+	if(dropped != dropped_reported)
+	{
+		fprintf(file, "%u records dropped since the ring was full\n", dropped - dropped_reported);
+		dropped_reported = dropped;
+	}
+
+	fflush(file);
+}
+
+static DWORD WINAPI drain_thread(void *)
+{
+	while(running)
+	{
+		drain();
+		Sleep(10);
+	}
+
+	return 0;
+}
+
+void Log::start(const std::string &path)
+{
+	if(running)
+		stop();
+
+	file = fopen(path.c_str(), "w");
+
+	if(!file)
+		error("Unable to create " + path);
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start_time);
+
+	ring = &shared->log;
+	dropped_reported = ring->dropped;
+
+	running = true;
+
+	thread_handle = CreateThread(0, 0, drain_thread, 0, 0, 0);
+
+	if(!thread_handle)
+	{
+		running = false;
+		fclose(file);
+		win32_error("Unable to create the log thread");
+	}
+}
+
+void Log::stop()
+{
+	if(!running)
+		return;
+
+	running = false;
+
+	WaitForSingleObject(thread_handle, INFINITE);
+	CloseHandle(thread_handle);
+
+	drain();
+
+	fclose(file);
+}
+
+void Log::write(Id id, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+	if(!ring)
+		return;
+
+	long position;
+
+	while(true)
+	{
+		position = ring->head;
+
+		if((size_t)(position - ring->tail) >= LogRing::capacity)
+		{
+			InterlockedIncrement(&ring->dropped);
+			return;
+		}
+
+		if(InterlockedCompareExchange(&ring->head, position + 1, position) == position)
+			break;
+	}
+
+	auto &record = ring->records[position & (LogRing::capacity - 1)];
+
+	LARGE_INTEGER time;
+
+	QueryPerformanceCounter(&time);
+
+	record.id = id;
+	record.time = time.QuadPart;
+	record.args[0] = arg0;
+	record.args[1] = arg1;
+	record.args[2] = arg2;
+	record.args[3] = arg3;
+
+	MemoryBarrier();
+
+	record.sequence = position + 1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "shade.hpp"
+
+namespace Shade
+{
+	/*
+		Host side of the log ring in the shared mapping (see external/log.hpp). Records are written without
+		blocking and a background thread formats them into a file, so logging doesn't hold up remote calls.
+	*/
+	namespace Log
+	{
+		void start(const std::string &path);
+		
+		// Drains the remaining records and closes the file
+		void stop();
+		
+		void write(Id id, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0);
+	};
+};
@@ -0,0 +1,209 @@
+#include "modules.hpp"
+#include "movement.hpp"
+#include "recorder.hpp"
+#include "requests.hpp"
+#include "log.hpp"
+#include <algorithm>
+
+using namespace Shade;
+
+static std::vector<Modules::Module> modules;
+static std::vector<std::vector<size_t>> waves;
+
+struct Task
+{
+	Modules::Module *module;
+	volatile long *remaining;
+	HANDLE done;
+};
+
+static void CALLBACK run_task(PTP_CALLBACK_INSTANCE instance, void *context)
+{
+	auto task = (Task *)context;
+
+	Requests::enter_task();
+
+	task->module->func((d3c_module_context_t)&task->module->context, task->module->user);
+
+	Requests::leave_task();
+
+	if(InterlockedDecrement(task->remaining) == 0)
+		SetEventWhenCallbackReturns(instance, task->done);
+}
+
+void Modules::add(const Module &module)
+{
+	modules.push_back(module);
+
+	auto &added = modules.back();
+
+	added.wave = 0;
+
+	for(size_t i = 0; i + 1 < modules.size(); ++i)
+	{
+		if((modules[i].writes & added.reads) && modules[i].wave + 1 > added.wave)
+			added.wave = modules[i].wave + 1;
+	}
+
+	if(waves.size() <= added.wave)
+		waves.resize(added.wave + 1);
+
+	waves[added.wave].push_back(modules.size() - 1);
+}
+
+static void run_wave(std::vector<size_t> &wave, HANDLE done)
+{
+	// A single module runs on the calling thread
+	if(wave.size() == 1)
+	{
+		auto &module = modules[wave[0]];
+
+		module.func((d3c_module_context_t)&module.context, module.user);
+
+		return;
+	}
+
+	volatile long remaining = (long)wave.size();
+	std::vector<Task> tasks(wave.size());
+
+	for(size_t i = 0; i < wave.size(); ++i)
+	{
+		Task task = {&modules[wave[i]], &remaining, done};
+
+		tasks[i] = task;
+	}
+
+	for(size_t i = 0; i < tasks.size(); ++i)
+	{
+		if(!TrySubmitThreadpoolCallback(run_task, &tasks[i], 0))
+		{
+			// Run the task here if it couldn't be queued
+			tasks[i].module->func((d3c_module_context_t)&tasks[i].module->context, tasks[i].module->user);
+
+			if(InterlockedDecrement(&remaining) == 0)
+				return;
+		}
+	}
+
+	WaitForSingleObject(done, INFINITE);
+}
+
+void Modules::run()
+{
+	if(modules.empty())
+		return;
+
+	LARGE_INTEGER frequency, start, stop;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	uint32_t data = 0;
+
+	for(auto module = modules.begin(); module != modules.end(); ++module)
+	{
+		data |= module->data;
+		module->context.actions.clear();
+		module->context.data.clear();
+	}
+
+	// Movement is polled first, since the thread can only hold one result at a time. Replays have no movement to poll.
+	if((data & D3C_DATA_MOVEMENT) && !Recorder::replaying)
+		Movement::update();
+
+	if(data & D3C_DATA_SNAPSHOT)
+		acquire_snapshot();
+
+	HANDLE done = CreateEvent(0, FALSE, FALSE, 0);
+
+	if(!done)
+		win32_error("Unable to create the module event");
+
+	for(auto wave = waves.begin(); wave != waves.end(); ++wave)
+		run_wave(*wave, done);
+
+	CloseHandle(done);
+
+	if(data & D3C_DATA_SNAPSHOT)
+		release_snapshot();
+
+	struct Entry
+	{
+		uint32_t channel;
+		size_t module;
+		size_t action;
+	};
+
+	std::vector<Entry> entries;
+
+	for(size_t i = 0; i < modules.size(); ++i)
+	{
+		auto &actions = modules[i].context.actions;
+
+		for(size_t j = 0; j < actions.size(); ++j)
+		{
+			Entry entry = {actions[j].channel, i, j};
+
+			entries.push_back(entry);
+		}
+	}
+
+	// Entries are added in module and emission order, so a stable sort by channel keeps that order within channels
+	std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+		return a.channel < b.channel;
+	});
+
+	WriteQueue queue;
+
+	for(auto entry = entries.begin(); entry != entries.end(); ++entry)
+	{
+		auto &context = modules[entry->module].context;
+		auto &action = context.actions[entry->action];
+
+		queue.add(action.address, &context.data[action.offset], action.size);
+	}
+
+	queue.flush();
+
+	QueryPerformanceCounter(&stop);
+
+	Log::write(Log::ModulesRan, modules.size(), waves.size(), entries.size(), (uint32_t)((stop.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart));
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_module_register(const char *name, uint32_t data, uint32_t reads, uint32_t writes, d3c_module_func_t func, void *user)
+{
+	return Shade::wrap([&] {
+		Modules::Module module;
+
+		module.name = name;
+		module.data = data;
+		module.reads = reads;
+		module.writes = writes;
+		module.func = func;
+		module.user = user;
+
+		Modules::add(module);
+	});
+}
+
+extern "C" D3C_EXPORT d3c_snapshot_t D3C_API d3c_module_snapshot(d3c_module_context_t context)
+{
+	return (d3c_snapshot_t)&shared->data;
+}
+
+extern "C" D3C_EXPORT void D3C_API d3c_module_emit(d3c_module_context_t handle, uint32_t channel, void *address, const void *data, size_t size)
+{
+	auto context = (Modules::Context *)handle;
+
+	Modules::Action action = {channel, address, context->data.size(), size};
+
+	context->data.insert(context->data.end(), (const char *)data, (const char *)data + size);
+	context->actions.push_back(action);
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_run_modules()
+{
+	return Shade::wrap([&] {
+		Modules::run();
+	});
+}
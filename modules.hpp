@@ -0,0 +1,50 @@
+#pragma once
+#include "shade.hpp"
+#include <functional>
+
+namespace Shade
+{
+	/*
+		Runs bot modules once per tick. Each module declares the data it needs, the action channels it reads and
+		the channels it writes. Modules are grouped into waves: a module runs in a wave after every earlier
+		registered module writing a channel it reads. The modules of a wave run in parallel on the Win32
+		thread pool against the same snapshot, which they must not release.
+		Actions are memory writes. They're merged by channel, then by module registration order, then by the
+		order they were emitted in, and submitted with a single write_batch, so the result doesn't depend on
+		which thread finished first. Reads only order modules, since no action is written before all waves ran.
+	*/
+	namespace Modules
+	{
+		struct Action
+		{
+			uint32_t channel;
+			void *address;
+			size_t offset; // Into Context::data
+			size_t size;
+		};
+
+		struct Context
+		{
+			std::vector<Action> actions;
+			std::vector<char> data;
+		};
+
+		struct Module
+		{
+			std::string name;
+			uint32_t data; // d3c_data_t flags
+			uint32_t reads;
+			uint32_t writes;
+			d3c_module_func_t func;
+			void *user;
+
+			size_t wave;
+			Context context;
+		};
+
+		void add(const Module &module);
+
+		// Runs all modules for the current tick and submits their actions
+		void run();
+	};
+};
@@ -0,0 +1,166 @@
+#include "movement.hpp"
+#include "requests.hpp"
+#include <cmath>
+
+using namespace Shade;
+
+std::unordered_map<uint32_t, Movement::Track> Movement::tracks;
+
+// The error rate decays so a single teleport doesn't widen the bound forever
+static const float error_decay = 0.9f;
+
+// Tracks which aren't updated for this long are dropped
+static const double track_lifetime = 10.0;
+
+double Movement::now()
+{
+	LARGE_INTEGER counter, frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	return (double)counter.QuadPart / frequency.QuadPart;
+}
+
+static void extrapolate(const Movement::Track &track, double time, float position[3])
+{
+	float elapsed = (float)(time - track.time);
+
+	if(!track.moving || elapsed <= 0.0f)
+	{
+		for(size_t i = 0; i < 3; ++i)
+			position[i] = track.position[i];
+
+		return;
+	}
+
+	float step[3];
+	float step_length = 0.0f;
+	float target_length = 0.0f;
+
+	for(size_t i = 0; i < 3; ++i)
+	{
+		step[i] = track.velocity[i] * elapsed;
+		step_length += step[i] * step[i];
+		target_length += (track.target[i] - track.position[i]) * (track.target[i] - track.position[i]);
+	}
+
+	// Actors stop at their destination
+	if(step_length >= target_length)
+	{
+		for(size_t i = 0; i < 3; ++i)
+			position[i] = track.target[i];
+
+		return;
+	}
+
+	for(size_t i = 0; i < 3; ++i)
+		position[i] = track.position[i] + step[i];
+}
+
+void Movement::update()
+{
+	bool fresh;
+
+	if(Requests::acquire(Call::ListMovement, 0, &fresh) != Error::None)
+		error("Unable to list actor movement");
+
+	// Another consumer already applied this poll
+	if(!fresh)
+	{
+		Requests::release();
+		return;
+	}
+
+	double time = now();
+
+	Remote::Movement &columns = *shared->data.movement;
+
+	size_t *actor_ids = columns.actor_id;
+	size_t *frames = columns.frame;
+	float *speeds = columns.speed;
+	Remote::Vector3 *positions = columns.position;
+	Remote::Vector3 *targets = columns.moving_to;
+
+	for(size_t i = 0; i < columns.count; ++i)
+	{
+		float position[3] = {positions[i].x, positions[i].y, positions[i].z};
+
+		// New tracks are value initialized, so they start without velocity or error
+		auto result = tracks.insert(std::make_pair((uint32_t)actor_ids[i], Track()));
+		Track &track = result.first->second;
+
+		if(!result.second)
+		{
+			float elapsed = (float)(time - track.time);
+
+			if(elapsed <= 0.0f)
+				continue;
+
+			float predicted[3];
+
+			extrapolate(track, time, predicted);
+
+			float error = 0.0f;
+
+			for(size_t j = 0; j < 3; ++j)
+			{
+				error += (predicted[j] - position[j]) * (predicted[j] - position[j]);
+				track.velocity[j] = (position[j] - track.position[j]) / elapsed;
+			}
+
+			float rate = sqrtf(error) / elapsed;
+
+			track.error_rate = track.error_rate * error_decay > rate ? track.error_rate * error_decay : rate;
+		}
+
+		track.time = time;
+		track.frame = frames[i];
+		track.moving = speeds[i] > 0.0f;
+
+		for(size_t j = 0; j < 3; ++j)
+			track.position[j] = position[j];
+
+		track.target[0] = targets[i].x;
+		track.target[1] = targets[i].y;
+		track.target[2] = targets[i].z;
+	}
+
+	Requests::release();
+
+	for(auto i = tracks.begin(); i != tracks.end();)
+	{
+		if(time - i->second.time > track_lifetime)
+			i = tracks.erase(i);
+		else
+			++i;
+	}
+}
+
+bool Movement::predict(uint32_t actor_id, double time, float position[3], float &error)
+{
+	auto result = tracks.find(actor_id);
+
+	if(result == tracks.end())
+		return false;
+
+	Track &track = result->second;
+
+	extrapolate(track, time, position);
+
+	error = time > track.time ? track.error_rate * (float)(time - track.time) : 0.0f;
+
+	return true;
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_movement_update()
+{
+	return Shade::wrap([&] {
+		Movement::update();
+	});
+}
+
+extern "C" D3C_EXPORT int D3C_API d3c_predict_position(uint32_t actor_id, double delay, float position[3], float *error)
+{
+	return Movement::predict(actor_id, Movement::now() + delay, position, *error);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "shade.hpp"
+#include <unordered_map>
+
+namespace Shade
+{
+	/*
+		Predicts actor positions between polls of the movement columns.
+		Each actor is extrapolated with the velocity measured between its last two polls and stops at the
+		position it's moving to. The error bound is the largest error seen per second of extrapolation for
+		that actor, scaled by the time since the last poll. It's an estimate, not a guarantee.
+	*/
+	namespace Movement
+	{
+		struct Track
+		{
+			double time; // Seconds on the QueryPerformanceCounter clock when the actor was last polled
+			float position[3];
+			float velocity[3]; // Units per second
+			float target[3];
+			float error_rate; // Units of error per second of extrapolation
+			size_t frame;
+			bool moving;
+		};
+
+		extern std::unordered_map<uint32_t, Track> tracks;
+
+		double now();
+
+		// Polls the movement of all actors and updates the tracks
+		void update();
+
+		// Returns false if the actor hasn't been polled
+		bool predict(uint32_t actor_id, double time, float position[3], float &error);
+	};
+};
@@ -0,0 +1,355 @@
+#include "names.hpp"
+#include <algorithm>
+
+using namespace Shade;
+
+NameIndex Shade::names;
+
+// Searches for more distinct fragments than this start over with an empty result cache
+static const size_t max_results = 0x100;
+
+uint32_t NameIndex::intern(const std::string &name)
+{
+	// Most names are already interned, so they're looked up without excluding other threads first
+	AcquireSRWLockShared(&lock);
+
+	auto existing = ids.find(name);
+	bool found = existing != ids.end();
+	uint32_t id = found ? existing->second : 0;
+
+	// Other threads holding the lock shared may mark the same name
+	if(found && used[id] != epoch)
+		InterlockedExchange(&used[id], epoch);
+
+	ReleaseSRWLockShared(&lock);
+
+	if(found)
+		return id;
+
+	AcquireSRWLockExclusive(&lock);
+
+	existing = ids.find(name);
+
+	if(existing != ids.end())
+		id = existing->second;
+	else
+	{
+		if(free_ids.empty())
+		{
+			id = names.size();
+			names.push_back(name);
+			used.push_back(epoch);
+		}
+		else
+		{
+			id = free_ids.back();
+			free_ids.pop_back();
+			names[id] = name;
+		}
+
+		used[id] = epoch;
+		ids[name] = id;
+		pending.push_back(id);
+	}
+
+	ReleaseSRWLockExclusive(&lock);
+
+	return id;
+}
+
+std::string NameIndex::name(uint32_t id)
+{
+	AcquireSRWLockShared(&lock);
+
+	std::string result = names[id];
+
+	ReleaseSRWLockShared(&lock);
+
+	return result;
+}
+
+size_t NameIndex::size()
+{
+	AcquireSRWLockShared(&lock);
+
+	size_t result = names.size() - free_ids.size();
+
+	ReleaseSRWLockShared(&lock);
+
+	return result;
+}
+
+void NameIndex::update()
+{
+	if(pending.empty())
+		return;
+
+	size_t old_suffixes = suffixes.size();
+	size_t old_sorted = sorted.size();
+
+	for(auto id = pending.begin(); id != pending.end(); ++id)
+	{
+		auto &name = names[*id];
+
+		starts.push_back(text.size());
+		owners.push_back(*id);
+
+		for(size_t i = 0; i < name.size(); ++i)
+			suffixes.push_back(text.size() + i);
+
+		text.insert(text.end(), name.begin(), name.end());
+		text.push_back(0);
+
+		sorted.push_back(*id);
+	}
+
+	// The separators end each suffix at the end of its name, so strcmp only compares within names
+	const char *base = &text[0];
+
+	auto by_suffix = [&](uint32_t a, uint32_t b) {
+		return strcmp(base + a, base + b) < 0;
+	};
+
+	auto by_name = [&](uint32_t a, uint32_t b) {
+		return names[a] < names[b];
+	};
+
+	// Only the new entries are sorted, then they're merged with the old ones
+	std::sort(suffixes.begin() + old_suffixes, suffixes.end(), by_suffix);
+	std::inplace_merge(suffixes.begin(), suffixes.begin() + old_suffixes, suffixes.end(), by_suffix);
+
+	std::sort(sorted.begin() + old_sorted, sorted.end(), by_name);
+	std::inplace_merge(sorted.begin(), sorted.begin() + old_sorted, sorted.end(), by_name);
+
+	// Cached results only need the new names which match
+	for(auto i = substring_results.begin(); i != substring_results.end(); ++i)
+	{
+		for(auto id = pending.begin(); id != pending.end(); ++id)
+		{
+			if(names[*id].find(i->first) != std::string::npos)
+				i->second.push_back(*id);
+		}
+
+		std::sort(i->second.begin(), i->second.end());
+	}
+
+	for(auto i = prefix_results.begin(); i != prefix_results.end(); ++i)
+	{
+		for(auto id = pending.begin(); id != pending.end(); ++id)
+		{
+			if(names[*id].compare(0, i->first.size(), i->first) == 0)
+				i->second.push_back(*id);
+		}
+
+		std::sort(i->second.begin(), i->second.end());
+	}
+
+	pending.clear();
+}
+
+void NameIndex::retire()
+{
+	update();
+
+	std::vector<char> dropped(names.size());
+	size_t count = 0;
+
+	for(size_t id = 0; id < names.size(); ++id)
+	{
+		if(used[id] != retired && epoch - used[id] > max_age)
+		{
+			dropped[id] = 1;
+			count++;
+		}
+	}
+
+	if(!count)
+		return;
+
+	// The remaining names keep their order in 'text', so the suffix array stays sorted when their offsets move
+	std::vector<char> kept_text;
+	std::vector<uint32_t> kept_starts;
+	std::vector<uint32_t> kept_owners;
+	std::vector<uint32_t> shift(starts.size());
+
+	for(size_t i = 0; i < starts.size(); ++i)
+	{
+		auto &name = names[owners[i]];
+
+		if(dropped[owners[i]])
+			continue;
+
+		shift[i] = starts[i] - kept_text.size();
+
+		kept_starts.push_back(kept_text.size());
+		kept_owners.push_back(owners[i]);
+
+		kept_text.insert(kept_text.end(), name.begin(), name.end());
+		kept_text.push_back(0);
+	}
+
+	size_t kept = 0;
+
+	for(size_t i = 0; i < suffixes.size(); ++i)
+	{
+		size_t entry = std::upper_bound(starts.begin(), starts.end(), suffixes[i]) - starts.begin() - 1;
+
+		if(!dropped[owners[entry]])
+			suffixes[kept++] = suffixes[i] - shift[entry];
+	}
+
+	suffixes.resize(kept);
+
+	auto is_dropped = [&](uint32_t id) {
+		return dropped[id] != 0;
+	};
+
+	sorted.erase(std::remove_if(sorted.begin(), sorted.end(), is_dropped), sorted.end());
+
+	for(auto i = substring_results.begin(); i != substring_results.end(); ++i)
+		i->second.erase(std::remove_if(i->second.begin(), i->second.end(), is_dropped), i->second.end());
+
+	for(auto i = prefix_results.begin(); i != prefix_results.end(); ++i)
+		i->second.erase(std::remove_if(i->second.begin(), i->second.end(), is_dropped), i->second.end());
+
+	text.swap(kept_text);
+	starts.swap(kept_starts);
+	owners.swap(kept_owners);
+
+	for(size_t id = 0; id < names.size(); ++id)
+	{
+		if(!dropped[id])
+			continue;
+
+		ids.erase(names[id]);
+		std::string().swap(names[id]);
+		used[id] = retired;
+		free_ids.push_back(id);
+	}
+}
+
+void NameIndex::next_epoch()
+{
+	AcquireSRWLockExclusive(&lock);
+
+	epoch++;
+
+	// Looking for unused names visits all of them, so it's only done every few epochs
+	if(names.size() - free_ids.size() > limit && epoch % (max_age / 4) == 0)
+		retire();
+
+	ReleaseSRWLockExclusive(&lock);
+}
+
+// Returns the id of the name containing the text offset
+uint32_t NameIndex::owner(uint32_t offset)
+{
+	return owners[std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1];
+}
+
+std::vector<uint32_t> NameIndex::find(const std::string &fragment)
+{
+	AcquireSRWLockExclusive(&lock);
+
+	std::vector<uint32_t> result = search(fragment);
+
+	ReleaseSRWLockExclusive(&lock);
+
+	return result;
+}
+
+std::vector<uint32_t> NameIndex::find_prefix(const std::string &prefix)
+{
+	AcquireSRWLockExclusive(&lock);
+
+	std::vector<uint32_t> result = search_prefix(prefix);
+
+	ReleaseSRWLockExclusive(&lock);
+
+	return result;
+}
+
+const std::vector<uint32_t> &NameIndex::search(const std::string &fragment)
+{
+	update();
+
+	auto cached = substring_results.find(fragment);
+
+	if(cached != substring_results.end())
+		return cached->second;
+
+	if(substring_results.size() >= max_results)
+		substring_results.clear();
+
+	std::vector<uint32_t> &result = substring_results[fragment];
+
+	if(fragment.empty())
+	{
+		result = owners;
+
+		std::sort(result.begin(), result.end());
+
+		return result;
+	}
+
+	const char *base = text.empty() ? 0 : &text[0];
+	const char *pattern = fragment.c_str();
+	size_t length = fragment.size();
+
+	// The suffixes starting with the fragment are a contiguous range
+	size_t low = 0;
+	size_t high = suffixes.size();
+
+	while(low < high)
+	{
+		size_t middle = (low + high) / 2;
+
+		if(strncmp(base + suffixes[middle], pattern, length) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for(size_t i = low; i < suffixes.size() && strncmp(base + suffixes[i], pattern, length) == 0; ++i)
+		result.push_back(owner(suffixes[i]));
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+
+	return result;
+}
+
+const std::vector<uint32_t> &NameIndex::search_prefix(const std::string &prefix)
+{
+	update();
+
+	auto cached = prefix_results.find(prefix);
+
+	if(cached != prefix_results.end())
+		return cached->second;
+
+	if(prefix_results.size() >= max_results)
+		prefix_results.clear();
+
+	std::vector<uint32_t> &result = prefix_results[prefix];
+
+	size_t low = 0;
+	size_t high = sorted.size();
+
+	while(low < high)
+	{
+		size_t middle = (low + high) / 2;
+
+		if(names[sorted[middle]].compare(0, prefix.size(), prefix) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for(size_t i = low; i < sorted.size() && names[sorted[i]].compare(0, prefix.size(), prefix) == 0; ++i)
+		result.push_back(sorted[i]);
+
+	std::sort(result.begin(), result.end());
+
+	return result;
+}
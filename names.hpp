@@ -0,0 +1,73 @@
+#pragma once
+#include "shade.hpp"
+#include <unordered_map>
+
+namespace Shade
+{
+	/*
+		Index of unique names for substring and prefix searches.
+		Names are interned once and keep their id while they're in use, so ids can be stored in records and
+		compared across snapshots. Searches use a suffix array over all names and return sorted name ids.
+		New names are sorted on their own and merged into the suffix array, and cached results are only
+		extended with the names that match, so results stay cached across snapshots.
+		Actor names include instance numbers, so once the index holds more than 'limit' names, names which
+		weren't interned for 'max_age' epochs are dropped and their ids reused.
+		The index is shared by modules running in parallel, so it's guarded by a lock and searches return copies.
+	*/
+	class NameIndex
+	{
+		static const size_t limit = 0x4000;
+		static const LONG max_age = 0x1000;
+		static const LONG retired = -1; // Epoch of ids which are free
+
+		std::vector<std::string> names;
+		std::vector<LONG> used; // Epoch each name was last interned in
+		std::vector<uint32_t> free_ids;
+		std::unordered_map<std::string, uint32_t> ids;
+		LONG epoch;
+
+		std::vector<char> text; // All indexed names, each followed by a zero
+		std::vector<uint32_t> starts; // Offset of each indexed name in 'text', in order
+		std::vector<uint32_t> owners; // Id of the name at each offset in 'starts'
+		std::vector<uint32_t> suffixes; // Offsets in 'text' sorted by the suffix starting there
+		std::vector<uint32_t> sorted; // Name ids sorted by name
+		std::vector<uint32_t> pending; // Ids of names which aren't indexed yet
+
+		std::unordered_map<std::string, std::vector<uint32_t>> substring_results;
+		std::unordered_map<std::string, std::vector<uint32_t>> prefix_results;
+
+		SRWLOCK lock;
+
+		void update();
+		void retire();
+		uint32_t owner(uint32_t offset);
+
+		// These must be called with the lock held exclusively
+		const std::vector<uint32_t> &search(const std::string &fragment);
+		const std::vector<uint32_t> &search_prefix(const std::string &prefix);
+
+	public:
+		NameIndex() : epoch(0)
+		{
+			InitializeSRWLock(&lock);
+		}
+
+		uint32_t intern(const std::string &name);
+
+		std::string name(uint32_t id);
+
+		size_t size();
+
+		// Returns the ids of names containing 'fragment'
+		std::vector<uint32_t> find(const std::string &fragment);
+
+		// Returns the ids of names starting with 'prefix'
+		std::vector<uint32_t> find_prefix(const std::string &prefix);
+
+		// Called once for each game tick, drops unused names if there are too many
+		void next_epoch();
+	};
+
+	// Names of actors, ACDs and UI elements
+	extern NameIndex names;
+};
@@ -61,7 +61,26 @@ void Shade::set_privilege(HANDLE token, const char *privilege)
 		win32_error("Unable to adjust token privileges");
 }
 
-void Shade::get_debug_privileges()
+// Returns false if the privilege isn't held by the user instead of raising an error
+bool Shade::try_set_privilege(HANDLE token, const char *privilege)
+{
+	TOKEN_PRIVILEGES token_privileges;
+
+	memset(&token_privileges, 0, sizeof(TOKEN_PRIVILEGES));
+
+	if(!LookupPrivilegeValueA(0, privilege, &token_privileges.Privileges[0].Luid))
+		return false;
+
+	token_privileges.PrivilegeCount = 1;
+	token_privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	if(!AdjustTokenPrivileges(token, FALSE, &token_privileges, 0, 0, 0))
+		return false;
+
+	return GetLastError() != ERROR_NOT_ALL_ASSIGNED;
+}
+
+static HANDLE thread_token()
 {
 	HANDLE token;
   
@@ -72,24 +91,94 @@ void Shade::get_debug_privileges()
 		if(err == ERROR_NO_TOKEN)
 		{
 			if(!ImpersonateSelf(SecurityImpersonation))
-				win32_error("Unable to impersonate self");
+				Shade::win32_error("Unable to impersonate self");
 
 			if(!OpenThreadToken(GetCurrentThread(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, FALSE, &token))
-				win32_error(err, "Unable to open thread token");
+				Shade::win32_error(err, "Unable to open thread token");
 		}
 		else
-			win32_error(err, "Unable to open thread token");
+			Shade::win32_error(err, "Unable to open thread token");
 	}
 
+	return token;
+}
+
+void Shade::get_debug_privileges()
+{
+	HANDLE token = thread_token();
+
 	set_privilege(token, "SeDebugPrivilege");
+
+	CloseHandle(token);
+}
+
+bool Shade::large_pages = true;
+
+/*
+	Creates a mapping backed by large pages if they are enabled and the user holds SeLockMemoryPrivilege.
+	Returns 0 with a reason if large pages can't be used.
+*/
+static HANDLE create_large_page_mapping(std::string &reason)
+{
+	size_t large_page = GetLargePageMinimum();
+	const char *setting = getenv("SHADE_LARGE_PAGES");
+
+	if(setting && strcmp(setting, "0") == 0)
+		Shade::large_pages = false;
+
+	if(!Shade::large_pages)
+	{
+		reason = "disabled";
+		return 0;
+	}
+
+	if(!large_page || Shade::Shared::mapping_size % large_page)
+	{
+		reason = "not supported";
+		return 0;
+	}
+
+	HANDLE token = thread_token();
+
+	bool privilege = Shade::try_set_privilege(token, "SeLockMemoryPrivilege");
+
+	CloseHandle(token);
+
+	if(!privilege)
+	{
+		reason = "SeLockMemoryPrivilege is not held";
+		return 0;
+	}
+
+	HANDLE result = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE | SEC_COMMIT | SEC_LARGE_PAGES, 0, Shade::Shared::mapping_size, 0);
+
+	// ERROR_NO_SYSTEM_RESOURCES means there isn't enough contiguous physical memory
+	if(!result)
+	{
+		reason = "unavailable, " + Shade::win32_error_code(GetLastError());
+		reason.erase(reason.find_last_not_of(" \r\n") + 1);
+	}
+
+	return result;
 }
 
 void Shade::allocate_shared_memory()
 {
-	local.memory = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, Shared::mapping_size, 0); 
+	std::string reason;
+
+	local.memory = create_large_page_mapping(reason);
+
+	if(local.memory)
+		printf("Shared memory: %u MB backed by %u KB large pages\n", (unsigned)(Shared::mapping_size >> 20), (unsigned)(GetLargePageMinimum() >> 10));
+	else
+	{
+		local.memory = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, Shared::mapping_size, 0); 
 	
-	if(!local.memory)
-		win32_error("Unable to create file mapping handle");
+		if(!local.memory)
+			win32_error("Unable to create file mapping handle");
+
+		printf("Shared memory: %u MB backed by 4 KB pages, large pages %s\n", (unsigned)(Shared::mapping_size >> 20), reason.c_str());
+	}
 
 	if(!DuplicateHandle(GetCurrentProcess(), local.memory, process, &remote_memory, 0, FALSE, DUPLICATE_SAME_ACCESS))
 		win32_error("Unable to duplicate file mapping handle");
@@ -101,8 +190,8 @@ void Shade::allocate_shared_memory()
 	
 	heap.setup((void *)(shared + 1), 0);
 
-	create_event(local.start, shared->event_start);
-	create_event(local.end, shared->event_end);
+	create_event(local.start, shared->event_start, shared->handshake_start);
+	create_event(local.end, shared->event_end, shared->handshake_end);
 	
 	if(!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), process, &shared->event_thread, 0, FALSE, DUPLICATE_SAME_ACCESS))
 		win32_error("Unable to duplicate thread handle");
@@ -132,7 +221,10 @@ void Shade::create_process()
 
 void Shade::signal_event(Event &event)
 {
-	if(!SetEvent(event.event))
+	// InterlockedIncrement is a full barrier, so 'parked' is read after the new sequence is visible
+	InterlockedIncrement(&event.handshake->sequence);
+
+	if(event.handshake->parked && !SetEvent(event.event))
 		win32_error("Unable to signal event");
 }
 
@@ -142,10 +234,13 @@ void Shade::reset_event(Event &event)
 		win32_error("Unable to reset event");
 }
 
-void Shade::create_event(Event &local, HANDLE &remote)
+void Shade::create_event(Event &local, HANDLE &remote, Handshake &handshake)
 {
 	local.event = CreateEvent(NULL, TRUE, FALSE, NULL);
 	local.thread = thread;
+	local.handshake = &handshake;
+	local.seen = handshake.sequence;
+	local.spin_limit = Handshake::spin_min;
 	
 	if(!local.event)
 		win32_error("Unable to create event");
@@ -154,19 +249,60 @@ void Shade::create_event(Event &local, HANDLE &remote)
 		win32_error("Unable to duplicate event handle");
 }
 
+/*
+	Spins on the sequence counter before blocking on the event. The spin limit doubles when the
+	signal arrives while spinning and halves when the wait ends up blocking, so it adapts to how
+	busy the remote side is.
+*/
 void Shade::wait_event(Event &event)
 {
-	auto result = WaitForMultipleObjects(2, &event.event, FALSE, INFINITE);
-	
-	if(result != WAIT_OBJECT_0)
+	auto handshake = event.handshake;
+
+	for(size_t i = 0; i < event.spin_limit; ++i)
 	{
-		if(result == WAIT_OBJECT_0 + 1)
-			error("Remote main thread terminated while wailing for event");
-		else if(result == WAIT_FAILED)
-			win32_error("Failed to wait for remote code");
-		else
-			error("Unable to wait for remote code");
+		if(handshake->sequence != event.seen)
+		{
+			event.seen = handshake->sequence;
+
+			if(event.spin_limit < Handshake::spin_max)
+				event.spin_limit *= 2;
+
+			return;
+		}
+
+		YieldProcessor();
+	}
+
+	if(event.spin_limit > Handshake::spin_min)
+		event.spin_limit /= 2;
+
+	while(true)
+	{
+		// The exchange is a full barrier, so the sequence is read after 'parked' is visible to the signaling side
+		InterlockedExchange(&handshake->parked, 1);
+
+		if(handshake->sequence != event.seen)
+			break;
+
+		auto result = WaitForMultipleObjects(2, &event.event, FALSE, INFINITE);
+		
+		if(result != WAIT_OBJECT_0)
+		{
+			if(result == WAIT_OBJECT_0 + 1)
+				error("Remote main thread terminated while wailing for event");
+			else if(result == WAIT_FAILED)
+				win32_error("Failed to wait for remote code");
+			else
+				error("Unable to wait for remote code");
+		}
+
+		// The event may have been left signaled by an earlier round, so the sequence is checked again
+		reset_event(event);
 	}
+
+	InterlockedExchange(&handshake->parked, 0);
+
+	event.seen = handshake->sequence;
 }
 
 void Shade::resume_process()
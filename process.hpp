@@ -6,7 +6,10 @@ namespace Shade
 	struct Event
 	{
 		HANDLE event;
-		HANDLE thread;
+		HANDLE thread; // Must follow event
+		Handshake *handshake;
+		long seen; // The last sequence number seen by wait_event
+		size_t spin_limit;
 	};
 	
 	struct Local
@@ -25,13 +28,17 @@ namespace Shade
 
 	double avg_time_per_remote_call();
 
-	void create_event(Event &local, HANDLE &remote);
+	void create_event(Event &local, HANDLE &remote, Handshake &handshake);
 	void wait_event(Event &event);
 	void reset_event(Event &event);
 	void signal_event(Event &event);
 	
 	void get_debug_privileges();
 	void set_privilege(HANDLE token, const char *privilege);
+	bool try_set_privilege(HANDLE token, const char *privilege);
+	
+	// Back the shared mapping with large pages when possible. Set SHADE_LARGE_PAGES=0 to disable.
+	extern bool large_pages;
 	
 	void open_process(DWORD process_id, DWORD thread_id);
 	void find_process();
@@ -0,0 +1,71 @@
+#include "profile.hpp"
+#include <fstream>
+#include <sstream>
+
+#define SHADE_LAYOUT_VALUE_FIELD(type, field, offset) {#type "." #field, "layout_" #type "_" #field, offset},
+#define SHADE_LAYOUT_VALUE_SIZE(type, size) {#type ".size", "layout_" #type "_size", size},
+
+Shade::Layout::Value Shade::Layout::values[Shade::Layout::Count] = {
+	SHADE_LAYOUT(SHADE_LAYOUT_VALUE_FIELD, SHADE_LAYOUT_VALUE_SIZE)
+};
+
+#undef SHADE_LAYOUT_VALUE_FIELD
+#undef SHADE_LAYOUT_VALUE_SIZE
+
+void Shade::Layout::load_profile()
+{
+	std::ifstream file("layout.txt");
+	std::string line;
+
+	while(std::getline(file, line))
+	{
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream in(line);
+		std::string name, value;
+
+		if(!(in >> name >> value))
+			error("Invalid line in layout.txt: " + line);
+
+		char *end;
+		size_t number = strtoul(value.c_str(), &end, 0);
+
+		if(*end)
+			error("Invalid value for '" + name + "' in layout.txt: " + value);
+
+		size_t i = 0;
+
+		for(; i < Count; ++i)
+		{
+			if(name == values[i].name)
+			{
+				values[i].value = number;
+				break;
+			}
+		}
+
+		if(i == Count)
+			error("Unknown layout entry '" + name + "' in layout.txt");
+	}
+
+	// The host copies objects of the listed size, so fields must start inside them
+	for(size_t i = 0; i < Count; ++i)
+	{
+		std::string name = values[i].name;
+		std::string type = name.substr(0, name.find('.'));
+
+		if(name == type + ".size")
+			continue;
+
+		for(size_t j = 0; j < Count; ++j)
+		{
+			if(values[j].name == type + ".size" && values[i].value >= values[j].value)
+			{
+				std::ostringstream message;
+				message << "Offset of '" << name << "' in layout.txt is outside the " << values[j].value << " bytes of " << type;
+				error(message.str());
+			}
+		}
+	}
+}
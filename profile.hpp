@@ -0,0 +1,37 @@
+#pragma once
+#include "shade.hpp"
+#include "external/layout.hpp"
+
+namespace Shade
+{
+	namespace Layout
+	{
+		#define SHADE_LAYOUT_ENTRY_FIELD(type, field, offset) type##_##field,
+		#define SHADE_LAYOUT_ENTRY_SIZE(type, size) type##_size,
+
+		enum Entry
+		{
+			SHADE_LAYOUT(SHADE_LAYOUT_ENTRY_FIELD, SHADE_LAYOUT_ENTRY_SIZE)
+			Count
+		};
+
+		#undef SHADE_LAYOUT_ENTRY_FIELD
+		#undef SHADE_LAYOUT_ENTRY_SIZE
+
+		struct Value
+		{
+			const char *name; // Name used in the layout profile, like "Actor.name" or "Actor.size"
+			const char *symbol; // Name of the global referenced by remote code
+			size_t value;
+		};
+
+		extern Value values[Count];
+
+		/*
+			Loads layout.txt if it exists. Each line contains a name and a value, like:
+				Actor.name 0x8
+			Entries which aren't listed keep their 1.0.3.10235 defaults.
+		*/
+		void load_profile();
+	};
+};
@@ -0,0 +1,343 @@
+#include "query.hpp"
+#include "names.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <emmintrin.h>
+#include <intrin.h>
+
+using namespace Shade;
+
+void Query::Table::clear()
+{
+	column_names.clear();
+	columns.clear();
+	rows = 0;
+}
+
+std::vector<int32_t> &Query::Table::add_column(const std::string &name)
+{
+	column_names.push_back(name);
+	columns.push_back(std::vector<int32_t>());
+
+	return columns.back();
+}
+
+const std::vector<int32_t> &Query::Table::column(const std::string &name) const
+{
+	for(size_t i = 0; i < column_names.size(); ++i)
+	{
+		if(column_names[i] == name)
+			return columns[i];
+	}
+
+	error("Unknown query column '" + name + "'");
+}
+
+static int32_t name_id(Ptr<String> &name)
+{
+	return names.intern(name ? name->c_str() : "");
+}
+
+void Query::load_actors(Table &table)
+{
+	table.clear();
+
+	auto &ptr = table.add_column("ptr");
+	auto &name = table.add_column("name");
+	auto &id = table.add_column("id");
+	auto &acd_id = table.add_column("acd_id");
+	auto &world_id = table.add_column("world_id");
+
+	for(auto i = shared->data.actors->begin(); i != shared->data.actors->end(); ++i)
+	{
+		ptr.push_back((int32_t)(size_t)i().ptr);
+		name.push_back(name_id(i().name));
+		id.push_back(i().id);
+		acd_id.push_back(i().acd_id);
+		world_id.push_back(i().world_id);
+	}
+
+	table.rows = ptr.size();
+}
+
+void Query::load_acds(Table &table)
+{
+	table.clear();
+
+	auto &ptr = table.add_column("ptr");
+	auto &name = table.add_column("name");
+	auto &id = table.add_column("id");
+	auto &owner_id = table.add_column("owner_id");
+
+	for(auto i = shared->data.acds->begin(); i != shared->data.acds->end(); ++i)
+	{
+		ptr.push_back((int32_t)(size_t)i().ptr);
+		name.push_back(name_id(i().name));
+		id.push_back(i().id);
+		owner_id.push_back(i().owner_id);
+	}
+
+	table.rows = ptr.size();
+}
+
+static bool compare(int32_t a, Query::Compare compare, int32_t b)
+{
+	switch(compare)
+	{
+		case Query::Equal:
+			return a == b;
+
+		case Query::NotEqual:
+			return a != b;
+
+		case Query::Less:
+			return a < b;
+
+		case Query::LessEqual:
+			return a <= b;
+
+		case Query::Greater:
+			return a > b;
+
+		default:
+			return a >= b;
+	}
+}
+
+void Query::filter(const Table &table, const std::string &column, Compare op, int32_t value, Selection &result)
+{
+	auto &values = table.column(column);
+
+	result.clear();
+	result.reserve(table.rows);
+
+	__m128i constant = _mm_set1_epi32(value);
+
+	// NotEqual, LessEqual and GreaterEqual are the inverse of Equal, Greater and Less
+	int invert = op == NotEqual || op == LessEqual || op == GreaterEqual ? 0xF : 0;
+
+	size_t vector_end = table.rows & ~3;
+	size_t i = 0;
+
+	for(; i < vector_end; i += 4)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)&values[i]);
+		__m128i mask;
+
+		switch(op)
+		{
+			case Equal:
+			case NotEqual:
+				mask = _mm_cmpeq_epi32(block, constant);
+				break;
+
+			case Less:
+			case GreaterEqual:
+				mask = _mm_cmplt_epi32(block, constant);
+				break;
+
+			default:
+				mask = _mm_cmpgt_epi32(block, constant);
+				break;
+		}
+
+		int bits = _mm_movemask_ps(_mm_castsi128_ps(mask)) ^ invert;
+
+		while(bits)
+		{
+			unsigned long bit;
+
+			_BitScanForward(&bit, bits);
+
+			result.push_back(i + bit);
+
+			bits &= bits - 1;
+		}
+	}
+
+	for(; i < table.rows; ++i)
+	{
+		if(compare(values[i], op, value))
+			result.push_back(i);
+	}
+}
+
+void Query::refine(const Table &table, const std::string &column, Compare op, int32_t value, Selection &selection)
+{
+	auto &values = table.column(column);
+
+	size_t kept = 0;
+
+	for(size_t i = 0; i < selection.size(); ++i)
+	{
+		if(compare(values[selection[i]], op, value))
+			selection[kept++] = selection[i];
+	}
+
+	selection.resize(kept);
+}
+
+void Query::project(const Table &table, const std::string &column, const Selection &selection, std::vector<int32_t> &result)
+{
+	auto &values = table.column(column);
+
+	result.resize(selection.size());
+
+	for(size_t i = 0; i < selection.size(); ++i)
+		result[i] = values[selection[i]];
+}
+
+void Query::sort(const Table &table, const std::string &column, Selection &selection, bool descending)
+{
+	auto &values = table.column(column);
+
+	std::stable_sort(selection.begin(), selection.end(), [&](uint32_t a, uint32_t b) {
+		return descending ? values[a] > values[b] : values[a] < values[b];
+	});
+}
+
+void Query::top(const Table &table, const std::string &column, size_t count, Selection &selection, bool descending)
+{
+	auto &values = table.column(column);
+
+	if(count > selection.size())
+		count = selection.size();
+
+	// Ties are broken by row index so the result doesn't depend on the order of the selection
+	std::partial_sort(selection.begin(), selection.begin() + count, selection.end(), [&](uint32_t a, uint32_t b) {
+		if(values[a] != values[b])
+			return descending ? values[a] > values[b] : values[a] < values[b];
+
+		return a < b;
+	});
+
+	selection.resize(count);
+}
+
+void Query::group(const Table &table, const std::string &key, const std::string &value, const Selection &selection, std::vector<Group> &groups)
+{
+	auto &keys = table.column(key);
+	auto *values = value.empty() ? 0 : &table.column(value);
+
+	std::unordered_map<int32_t, size_t> lookup;
+
+	groups.clear();
+
+	for(size_t i = 0; i < selection.size(); ++i)
+	{
+		uint32_t row = selection[i];
+
+		auto result = lookup.insert(std::make_pair(keys[row], groups.size()));
+
+		if(result.second)
+		{
+			Group group = {keys[row], 0, 0};
+
+			groups.push_back(group);
+		}
+
+		Group &group = groups[result.first->second];
+
+		group.count++;
+
+		if(values)
+			group.sum += (*values)[row];
+	}
+
+	std::sort(groups.begin(), groups.end(), [](const Group &a, const Group &b) {
+		return a.key < b.key;
+	});
+}
+
+struct QueryHandle
+{
+	Query::Table table;
+	Query::Selection selection;
+	bool all; // The selection holds every row, so the first filter scans the whole column
+};
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_query_create(d3c_snapshot_t snapshot, d3c_query_source_t source, d3c_query_t *query)
+{
+	return Shade::wrap([&] {
+		auto handle = new QueryHandle;
+
+		if(source == D3C_QUERY_ACDS)
+			Query::load_acds(handle->table);
+		else
+			Query::load_actors(handle->table);
+
+		handle->selection.resize(handle->table.rows);
+
+		for(size_t i = 0; i < handle->table.rows; ++i)
+			handle->selection[i] = i;
+
+		handle->all = true;
+
+		*query = (d3c_query_t)handle;
+	});
+}
+
+extern "C" D3C_EXPORT void D3C_API d3c_query_free(d3c_query_t query)
+{
+	delete (QueryHandle *)query;
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_query_filter(d3c_query_t query, const char *column, d3c_compare_t compare, int32_t value)
+{
+	return Shade::wrap([&] {
+		auto handle = (QueryHandle *)query;
+
+		if(handle->all)
+			Query::filter(handle->table, column, (Query::Compare)compare, value, handle->selection);
+		else
+			Query::refine(handle->table, column, (Query::Compare)compare, value, handle->selection);
+
+		handle->all = false;
+	});
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_query_top(d3c_query_t query, const char *column, size_t count, int descending)
+{
+	return Shade::wrap([&] {
+		auto handle = (QueryHandle *)query;
+
+		Query::top(handle->table, column, count, handle->selection, descending != 0);
+
+		handle->all = false;
+	});
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_query_values(d3c_query_t query, const char *column, int32_t *values, size_t max, size_t *count)
+{
+	return Shade::wrap([&] {
+		auto handle = (QueryHandle *)query;
+
+		std::vector<int32_t> result;
+
+		Query::project(handle->table, column, handle->selection, result);
+
+		std::copy(result.begin(), result.begin() + std::min(max, result.size()), values);
+
+		*count = result.size();
+	});
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_query_group(d3c_query_t query, const char *key, const char *value, d3c_group_t *groups, size_t max, size_t *count)
+{
+	return Shade::wrap([&] {
+		auto handle = (QueryHandle *)query;
+
+		std::vector<Query::Group> result;
+
+		Query::group(handle->table, key, value ? value : "", handle->selection, result);
+
+		for(size_t i = 0; i < result.size() && i < max; ++i)
+		{
+			groups[i].key = result[i].key;
+			groups[i].count = result[i].count;
+			groups[i].sum = result[i].sum;
+		}
+
+		*count = result.size();
+	});
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "shade.hpp"
+#include <utility>
+
+namespace Shade
+{
+	/*
+		Queries over columnar copies of snapshot lists.
+		Every column holds 32-bit integers. Strings are stored as ids from the name index (see names.hpp),
+		so comparing names is an integer comparison and name searches map to sets of ids. Operations work on selections, which are lists of row
+		indices in ascending order unless they have been sorted. Filtering a whole column uses SSE2 and
+		compares four rows at a time. Later filters only visit the rows which are still selected.
+	*/
+	namespace Query
+	{
+		enum Compare
+		{
+			Equal,
+			NotEqual,
+			Less,
+			LessEqual,
+			Greater,
+			GreaterEqual
+		};
+
+		typedef std::vector<uint32_t> Selection;
+
+		struct Group
+		{
+			int32_t key;
+			size_t count;
+			int64_t sum;
+		};
+
+		class Table
+		{
+			std::vector<std::string> column_names;
+			std::vector<std::vector<int32_t>> columns;
+
+		public:
+			size_t rows;
+
+			Table() : rows(0) {}
+
+			void clear();
+
+			std::vector<int32_t> &add_column(const std::string &name);
+			const std::vector<int32_t> &column(const std::string &name) const;
+		};
+
+		// Columns: ptr, name, id, acd_id, world_id
+		void load_actors(Table &table);
+
+		// Columns: ptr, name, id, owner_id
+		void load_acds(Table &table);
+
+		// Selects the rows of the whole table matching the comparison
+		void filter(const Table &table, const std::string &column, Compare compare, int32_t value, Selection &result);
+
+		// Removes the rows from the selection which don't match the comparison
+		void refine(const Table &table, const std::string &column, Compare compare, int32_t value, Selection &selection);
+
+		void project(const Table &table, const std::string &column, const Selection &selection, std::vector<int32_t> &result);
+
+		void sort(const Table &table, const std::string &column, Selection &selection, bool descending = false);
+
+		// Keeps the 'count' rows with the lowest values, or highest if 'descending' is set, in order
+		void top(const Table &table, const std::string &column, size_t count, Selection &selection, bool descending = false);
+
+		// Counts the rows for each value of 'key' and sums 'value' for them. Groups are sorted by key.
+		void group(const Table &table, const std::string &key, const std::string &value, const Selection &selection, std::vector<Group> &groups);
+	};
+};
@@ -0,0 +1,295 @@
+#include "reader.hpp"
+#include "scanner.hpp"
+#include "profile.hpp"
+#include <algorithm>
+
+using namespace Shade;
+
+static size_t layout(Layout::Entry entry)
+{
+	return Layout::values[entry].value;
+}
+
+static void *symbol(Symbol::Type symbol)
+{
+	return (void *)(shared->symbols[symbol] + module_delta);
+}
+
+template<class T> static T read_value(const void *remote, size_t offset = 0)
+{
+	T result;
+
+	read((const char *)remote + offset, &result, sizeof(T));
+
+	return result;
+}
+
+// Reads a zero terminated string without reading across pages which may not be mapped
+static std::string read_text(const char *remote)
+{
+	std::string result;
+
+	if(!remote)
+		return result;
+
+	while(true)
+	{
+		char buffer[64];
+		size_t size = std::min(sizeof(buffer), 0x1000 - ((size_t)remote & 0xFFF));
+
+		if(!ReadProcessMemory(process, remote, buffer, size, 0))
+			return result;
+
+		size_t length = strnlen(buffer, size);
+
+		result.append(buffer, length);
+
+		if(length < size)
+			return result;
+
+		remote += size;
+	}
+}
+
+// Reads a fixed size character array at 'offset' in a local copy of an object of 'size' bytes
+static std::string read_string(const char *object, size_t size, size_t offset)
+{
+	if(offset >= size)
+		return std::string();
+
+	return std::string(object + offset, strnlen(object + offset, size - offset));
+}
+
+/*
+	The types of values in the schemas have the same size as the game fields on x86,
+	so they are copied without conversion.
+*/
+#define SHADE_SCHEMA_READ_SELF(name) record.name = remote;
+#define SHADE_SCHEMA_READ_VALUE(source, type, name, field) \
+	if(layout(Layout::source##_##field) + sizeof(type) <= size) \
+		memcpy(&record.name, object + layout(Layout::source##_##field), sizeof(type)); \
+	else \
+		record.name = type();
+#define SHADE_SCHEMA_READ_STRING(source, name, field) record.name = read_string(object, size, layout(Layout::source##_##field));
+#define SHADE_SCHEMA_READ_TEXT(source, name, field) record.name = read_text(*(const char **)(object + layout(Layout::source##_##field)));
+
+#define SHADE_RECORD_READ(record_type, schema) \
+	static void read_record(External::record_type &record, void *remote, const char *object, size_t size) \
+	{ \
+		schema(SHADE_SCHEMA_READ_SELF, SHADE_SCHEMA_READ_VALUE, SHADE_SCHEMA_READ_STRING, SHADE_SCHEMA_READ_TEXT) \
+	}
+
+SHADE_RECORD_READ(Actor, SHADE_SCHEMA_ACTOR)
+SHADE_RECORD_READ(ActorCommonData, SHADE_SCHEMA_ACTOR_COMMON_DATA)
+
+static void *find_object_list(const char *type)
+{
+	auto game_data = read_value<void *>(symbol(Symbol::GameData));
+
+	if(!game_data)
+		return 0;
+
+	size_t length = strlen(type) + 1;
+	std::vector<char> name(length);
+
+	// The first node is at the start of the LinkedList
+	auto node = read_value<void *>(game_data, layout(Layout::GameData_object_lists));
+
+	while(node)
+	{
+		auto list = read_value<void *>(node, layout(Layout::ObjectListNode_value));
+
+		read((const char *)list + layout(Layout::ObjectList_type), &name[0], length);
+
+		if(memcmp(&name[0], type, length) == 0)
+			return list;
+
+		node = read_value<void *>(node, layout(Layout::ObjectListNode_next));
+	}
+
+	return 0;
+}
+
+/*
+	Reads the slot array of an ObjectList in one call, then all the object arrays in a single batch.
+	'func' is called with the remote address and a local copy of each live object.
+*/
+template<class F> static void each_list_object(const char *list, size_t object_size, F func)
+{
+	size_t slot_size = read_value<size_t>(list, layout(Layout::ObjectList_slot_size));
+	size_t total = read_value<size_t>(list, layout(Layout::ObjectList_total_count));
+	auto slot_list = read_value<char **>(list, layout(Layout::ObjectList_slots));
+
+	if(!slot_size || !total || !slot_list || total > slot_size * slot_size)
+		return;
+
+	size_t slot_count = (total + slot_size - 1) / slot_size;
+
+	std::vector<char *> slots(slot_count);
+
+	read(slot_list, &slots[0], slot_count * sizeof(char *));
+
+	std::vector<char> objects(total * object_size);
+
+	std::vector<Transfer> transfers;
+
+	for(size_t j = 0; j < slot_count; ++j)
+	{
+		size_t count = std::min(slot_size, total - j * slot_size);
+
+		if(slots[j])
+		{
+			Transfer transfer = {slots[j], &objects[j * slot_size * object_size], count * object_size, false};
+
+			transfers.push_back(transfer);
+		}
+	}
+
+	read_batch(transfers);
+
+	for(auto transfer = transfers.begin(); transfer != transfers.end(); ++transfer)
+	{
+		if(!transfer->done)
+			continue;
+
+		for(size_t offset = 0; offset < transfer->size; offset += object_size)
+		{
+			const char *object = (const char *)transfer->local + offset;
+
+			if(*(const int32_t *)object != -1)
+				func((char *)transfer->remote + offset, object);
+		}
+	}
+}
+
+template<class F> static void each_object(const char *type, size_t object_size, F func)
+{
+	auto list = (const char *)find_object_list(type);
+
+	if(!list)
+		error(std::string("Unable to find the object list ") + type);
+
+	each_list_object(list, object_size, func);
+}
+
+void External::list_actors(std::vector<Actor> &actors)
+{
+	size_t size = layout(Layout::Actor_size);
+
+	each_object("RActors", size, [&](void *remote, const char *object) {
+		Actor actor;
+
+		read_record(actor, remote, object, size);
+
+		actors.push_back(actor);
+	});
+}
+
+void External::list_acds(std::vector<ActorCommonData> &acds)
+{
+	size_t size = layout(Layout::ActorCommonData_size);
+
+	each_object("ActorCommonData", size, [&](void *remote, const char *object) {
+		ActorCommonData acd;
+
+		read_record(acd, remote, object, size);
+
+		acds.push_back(acd);
+	});
+}
+
+void External::list_scenes(uint32_t world_id, std::vector<Scene> &scenes)
+{
+	auto object_manager = read_value<void *>(symbol(Symbol::ObjectManager));
+	auto list = read_value<const char *>(object_manager, layout(Layout::ObjectManager_scences));
+
+	if(!list)
+		return;
+
+	each_list_object(list, layout(Layout::Scene_size), [&](void *remote, const char *object) {
+		if(*(const uint32_t *)(object + layout(Layout::Scene_world_id)) != world_id)
+			return;
+
+		Scene scene;
+
+		scene.sno_id = *(const uint32_t *)(object + layout(Layout::Scene_sno_id));
+
+		memcpy(&scene.min_x, object + layout(Layout::Scene_min), sizeof(float) * 2);
+
+		scenes.push_back(scene);
+	});
+}
+
+/*
+	Reads the bucket table in one call and then follows all the chains in parallel,
+	reading one level of pairs per batch.
+*/
+void *External::find_ui_component(uint64_t hash)
+{
+	auto object_manager = read_value<void *>(symbol(Symbol::ObjectManager));
+	auto ui_manager = read_value<void *>(object_manager, layout(Layout::ObjectManager_ui_manager));
+	auto map = read_value<void *>(ui_manager, layout(Layout::UIManager_component_map));
+	auto table = read_value<void **>(map, layout(Layout::UIComponentMap_table));
+	uint32_t mask = read_value<uint32_t>(map, layout(Layout::UIComponentMap_mask));
+
+	if(mask >= 0x100000)
+		error("Invalid UI component map");
+
+	std::vector<void *> pairs(mask + 1);
+
+	read(table, &pairs[0], pairs.size() * sizeof(void *));
+
+	pairs.erase(std::remove(pairs.begin(), pairs.end(), (void *)0), pairs.end());
+
+	// The UIReference key starts with its hash
+	size_t next_offset = layout(Layout::UIComponentPair_next);
+	size_t hash_offset = layout(Layout::UIComponentPair_key);
+	size_t header_size = std::max(next_offset + sizeof(void *), hash_offset + sizeof(uint64_t));
+
+	std::vector<char> headers;
+
+	while(!pairs.empty())
+	{
+		headers.resize(pairs.size() * header_size);
+
+		std::vector<Transfer> transfers(pairs.size());
+
+		for(size_t i = 0; i < pairs.size(); ++i)
+		{
+			Transfer transfer = {pairs[i], &headers[i * header_size], header_size, false};
+
+			transfers[i] = transfer;
+		}
+
+		read_batch(transfers);
+
+		std::vector<void *> next;
+
+		for(auto transfer = transfers.begin(); transfer != transfers.end(); ++transfer)
+		{
+			if(!transfer->done)
+				continue;
+
+			auto header = (const char *)transfer->local;
+
+			if(*(const uint64_t *)(header + hash_offset) == hash)
+				return read_value<void *>(transfer->remote, layout(Layout::UIComponentPair_value));
+
+			auto pair = *(void **)(header + next_offset);
+
+			if(pair)
+				next.push_back(pair);
+		}
+
+		pairs.swap(next);
+	}
+
+	return 0;
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_find_ui_component(uint64_t hash, const void **ptr)
+{
+	return Shade::wrap([&] {
+		*ptr = External::find_ui_component(hash);
+	});
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "shade.hpp"
+#include <vector>
+
+/*
+	Host records are generated from the same schemas as the remote records (see external/schema.hpp),
+	but strings are stored in a std::string instead of the shared heap.
+*/
+#define SHADE_SCHEMA_RECORD_SELF(name) void *name;
+#define SHADE_SCHEMA_RECORD_VALUE(source, type, name, field) type name;
+#define SHADE_SCHEMA_RECORD_STRING(source, name, field) std::string name;
+
+#define SHADE_RECORD(record, schema) \
+	struct record \
+	{ \
+		schema(SHADE_SCHEMA_RECORD_SELF, SHADE_SCHEMA_RECORD_VALUE, SHADE_SCHEMA_RECORD_STRING, SHADE_SCHEMA_RECORD_STRING) \
+	};
+
+#define SHADE_SCHEMA_RECORD_DESCRIBE_SELF(name) out << "\n\t " #name ": " << record.name;
+#define SHADE_SCHEMA_RECORD_DESCRIBE_VALUE(source, type, name, field) out << "\n\t " #name ": " << record.name;
+#define SHADE_SCHEMA_RECORD_DESCRIBE_STRING(source, name, field) out << "\n\t " #name ": " << record.name;
+
+#define SHADE_RECORD_DESCRIBE(record_type, schema) \
+	template<class S> void describe(S &out, External::record_type &record) \
+	{ \
+		out << #record_type; \
+		schema(SHADE_SCHEMA_RECORD_DESCRIBE_SELF, SHADE_SCHEMA_RECORD_DESCRIBE_VALUE, SHADE_SCHEMA_RECORD_DESCRIBE_STRING, SHADE_SCHEMA_RECORD_DESCRIBE_STRING) \
+		out << "\n"; \
+	}
+
+namespace Shade
+{
+	/*
+		Reads game structures directly with ReadProcessMemory instead of running code in the game.
+		These don't wait for the remote tick so there is no frame of latency, but the game may modify
+		the structures while they are being read. Objects which can't be read are skipped.
+		Offsets are taken from the layout profile and symbols from the symbol table, like the remote code.
+	*/
+	namespace External
+	{
+		SHADE_RECORD(Actor, SHADE_SCHEMA_ACTOR)
+		SHADE_RECORD(ActorCommonData, SHADE_SCHEMA_ACTOR_COMMON_DATA)
+
+		void list_actors(std::vector<Actor> &actors);
+		void list_acds(std::vector<ActorCommonData> &acds);
+
+		// A loaded scene without its navigation cells
+		struct Scene
+		{
+			uint32_t sno_id;
+			float min_x;
+			float min_y;
+		};
+
+		void list_scenes(uint32_t world_id, std::vector<Scene> &scenes);
+
+		// Returns the address of the UIComponent with the hash or 0 if it doesn't exist
+		void *find_ui_component(uint64_t hash);
+	};
+};
@@ -0,0 +1,291 @@
+#include "recorder.hpp"
+#include "requests.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+using namespace Shade;
+
+static const uint32_t segment_magic = 0x43524853; // "SHRC"
+static const uint32_t segment_version = 3;
+
+struct FrameHeader
+{
+	uint64_t time; // Microseconds since the recording started
+	uint32_t heap_used;
+	uint32_t roots_size;
+};
+
+typedef decltype(((Shared *)0)->data) Roots;
+
+bool Recorder::replaying = false;
+
+static bool recording = false;
+static std::string record_path;
+static std::ofstream record_file;
+static size_t record_segment;
+static size_t record_segment_used;
+static LARGE_INTEGER record_start;
+static size_t record_frames;
+static uint64_t record_bytes;
+
+static std::string segment_name(const std::string &path, size_t index)
+{
+	std::stringstream name;
+
+	name << path << "." << std::setw(4) << std::setfill('0') << index;
+
+	return name.str();
+}
+
+static uint64_t elapsed(LARGE_INTEGER &start)
+{
+	LARGE_INTEGER now, frequency;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+
+	return (uint64_t)((now.QuadPart - start.QuadPart) * 1000000.0 / frequency.QuadPart);
+}
+
+static void open_segment()
+{
+	if(record_file.is_open())
+		record_file.close();
+
+	std::string name = segment_name(record_path, record_segment);
+
+	record_file.open(name.c_str(), std::ios::binary | std::ios::trunc);
+
+	if(!record_file)
+		error("Unable to create " + name);
+
+	record_file.write((const char *)&segment_magic, sizeof(segment_magic));
+	record_file.write((const char *)&segment_version, sizeof(segment_version));
+
+	record_segment_used = sizeof(segment_magic) + sizeof(segment_version);
+}
+
+void Recorder::start(const std::string &path)
+{
+	if(recording)
+		stop();
+
+	record_path = path;
+	record_segment = 0;
+	record_frames = 0;
+	record_bytes = 0;
+
+	open_segment();
+
+	QueryPerformanceCounter(&record_start);
+
+	recording = true;
+}
+
+void Recorder::stop()
+{
+	if(!recording)
+		return;
+
+	record_file.close();
+	recording = false;
+
+	printf("Recorded %u snapshots, %.1f MB in %u segments\n", record_frames, record_bytes / (1024.0 * 1024.0), record_segment + 1);
+}
+
+void Recorder::record()
+{
+	if(!recording)
+		return;
+
+	FrameHeader header;
+
+	header.time = elapsed(record_start);
+	header.heap_used = shared->heap_used;
+	header.roots_size = sizeof(Roots);
+
+	size_t size = sizeof(header) + sizeof(Roots) + header.heap_used;
+
+	// Segments always contain at least one snapshot
+	if(record_segment_used > sizeof(segment_magic) + sizeof(segment_version) && record_segment_used + size > segment_size)
+	{
+		record_segment++;
+		open_segment();
+	}
+
+	record_file.write((const char *)&header, sizeof(header));
+	record_file.write((const char *)&shared->data, sizeof(Roots));
+	record_file.write((const char *)heap.start, header.heap_used);
+
+	if(!record_file)
+		error("Unable to write " + segment_name(record_path, record_segment));
+
+	record_segment_used += size;
+	record_frames++;
+	record_bytes += size;
+}
+
+// Waits until the recorded time of a snapshot, scaled by 'speed', has passed since the replay started
+static void wait_until(uint64_t time, double speed, LARGE_INTEGER &start)
+{
+	if(speed <= 0.0)
+		return;
+
+	uint64_t target = (uint64_t)(time / speed);
+
+	while(true)
+	{
+		uint64_t now = elapsed(start);
+
+		if(now >= target)
+			break;
+
+		// Sleep has a resolution of a few milliseconds so the rest is spent yielding
+		if(target - now > 2000)
+			Sleep((DWORD)((target - now) / 1000) - 1);
+		else
+			SwitchToThread();
+	}
+}
+
+static void load_segments(const std::string &path, std::function<void (uint64_t time)> &func)
+{
+	size_t heap_size = Shared::mapping_size - sizeof(Shared);
+
+	for(size_t segment = 0;; ++segment)
+	{
+		std::string name = segment_name(path, segment);
+		std::ifstream file(name.c_str(), std::ios::binary);
+
+		if(!file.is_open())
+		{
+			if(segment == 0)
+				error("Unable to open " + name);
+
+			break;
+		}
+
+		uint32_t magic, version;
+
+		if(file.read((char *)&magic, sizeof(magic)).fail() || file.read((char *)&version, sizeof(version)).fail())
+			error("Unable to read " + name);
+
+		if(magic != segment_magic || version != segment_version)
+			error(name + " is not a snapshot recording");
+
+		FrameHeader header;
+
+		while(!file.read((char *)&header, sizeof(header)).fail())
+		{
+			if(header.roots_size != sizeof(Roots) || header.heap_used > heap_size)
+				error(name + " is corrupt");
+
+			if(file.read((char *)&shared->data, sizeof(Roots)).fail() || file.read((char *)heap.start, header.heap_used).fail())
+				error(name + " is truncated");
+
+			shared->heap_used = header.heap_used;
+
+			heap_resets++;
+
+			func(header.time);
+		}
+	}
+}
+
+void Recorder::load(const std::string &path, std::function<void (uint64_t time)> func)
+{
+	// The snapshots are loaded into a local buffer laid out like the shared mapping, which is put back afterwards
+	auto buffer = (Shared *)VirtualAlloc(0, Shared::mapping_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+	if(!buffer)
+		win32_error("Unable to allocate replay memory");
+
+	Shared *live_shared = shared;
+	Heap live_heap = heap;
+
+	shared = buffer;
+	heap.setup((void *)(shared + 1), 0);
+
+	try
+	{
+		load_segments(path, func);
+	}
+	catch(...)
+	{
+		shared = live_shared;
+		heap = live_heap;
+		VirtualFree(buffer, 0, MEM_RELEASE);
+		throw;
+	}
+
+	shared = live_shared;
+	heap = live_heap;
+	VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+void Recorder::replay(const std::string &path, double speed, d3c_tick_t tick_func)
+{
+	size_t frames = 0;
+	uint64_t bytes = 0;
+	uint64_t first_time = 0;
+
+	LARGE_INTEGER start;
+
+	QueryPerformanceCounter(&start);
+
+	// Replayed snapshots are held through Requests, which d3c_init may not have set up
+	Requests::init();
+
+	replaying = true;
+
+	try
+	{
+		load(path, [&](uint64_t time) {
+			if(!frames)
+				first_time = time;
+
+			wait_until(time - first_time, speed, start);
+
+			if(Requests::held())
+				error("A snapshot must be released before the next snapshot is replayed");
+
+			tick_func();
+
+			frames++;
+			bytes += sizeof(FrameHeader) + sizeof(Roots) + shared->heap_used;
+		});
+	}
+	catch(...)
+	{
+		replaying = false;
+		throw;
+	}
+
+	replaying = false;
+
+	double seconds = elapsed(start) / 1000000.0;
+
+	printf("Replayed %u snapshots, %.1f MB in %.3f s (%.1f snapshots/s)\n", frames, bytes / (1024.0 * 1024.0), seconds, seconds > 0.0 ? frames / seconds : 0.0);
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_record_start(const char *path)
+{
+	return Shade::wrap([&] {
+		Recorder::start(path);
+	});
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_record_stop()
+{
+	return Shade::wrap([&] {
+		Recorder::stop();
+	});
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_replay(const char *path, double speed, d3c_tick_t tick_func)
+{
+	return Shade::wrap([&] {
+		Recorder::replay(path, speed, tick_func);
+	});
+}
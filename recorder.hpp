@@ -0,0 +1,34 @@
+#pragma once
+#include "shade.hpp"
+#include <functional>
+
+namespace Shade
+{
+	/*
+		Records the snapshots of a session so they can be replayed without the game.
+		A snapshot is the used part of the shared heap and the roots in Shared::data. Ptr offsets are relative to
+		the start of the heap, so the bytes are valid in any mapping. Snapshots are appended in order with the
+		time they were taken to a series of segment files named <path>.0000, <path>.0001 and so on.
+	*/
+	namespace Recorder
+	{
+		static const size_t segment_size = 0x10000000;
+
+		extern bool replaying;
+
+		void start(const std::string &path);
+		void stop();
+
+		// Appends the snapshot currently in the shared mapping. Does nothing unless recording.
+		void record();
+
+		// Loads each recorded snapshot into a local mapping and calls 'func' with the time it was recorded at
+		void load(const std::string &path, std::function<void (uint64_t time)> func);
+
+		/*
+			Loads each recorded snapshot into a local mapping and calls tick_func, which can acquire it through the C API.
+			'speed' scales the recorded time between snapshots. 0 replays as fast as possible.
+		*/
+		void replay(const std::string &path, double speed, d3c_tick_t tick_func);
+	};
+};
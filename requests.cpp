@@ -0,0 +1,387 @@
+#include "requests.hpp"
+#include <unordered_map>
+#include <algorithm>
+
+using namespace Shade;
+
+typedef decltype(((Shared *)0)->data) Roots;
+
+struct SavedResult
+{
+	uint64_t frame;
+	Roots roots;
+	size_t heap_used;
+	std::vector<char> heap;
+};
+
+size_t Requests::ttl = 0;
+
+static bool initialized;
+static CRITICAL_SECTION lock;
+static CONDITION_VARIABLE changed;
+
+static uint64_t frame;
+
+static bool resident;
+static uint64_t resident_key;
+static uint64_t resident_frame;
+static size_t resident_resets; // Value of heap_resets when the result was made resident
+
+static bool in_flight;
+static uint64_t in_flight_key;
+static DWORD in_flight_thread;
+
+static const uint64_t direct_key = (uint64_t)-1; // Key of calls made without a request
+
+static uint64_t generation; // Incremented when earlier results are no longer valid
+
+static std::vector<DWORD> holders; // Threads holding the resident result
+static std::vector<DWORD> tasks; // Threads running work a holder waits for
+static std::unordered_map<uint64_t, SavedResult> saved;
+
+static uint64_t calls;
+static uint64_t resident_hits;
+static uint64_t restored_hits;
+static uint64_t coalesced;
+static uint64_t saved_bytes;
+
+static bool is_fresh(uint64_t made)
+{
+	return frame - made <= Requests::ttl;
+}
+
+static bool is_resident(uint64_t key)
+{
+	return resident && resident_key == key && resident_resets == heap_resets && is_fresh(resident_frame);
+}
+
+static void make_resident(uint64_t key, uint64_t made)
+{
+	resident = true;
+	resident_key = key;
+	resident_frame = made;
+	resident_resets = heap_resets;
+}
+
+// Copies the resident result to the host before the next call resets the heap
+static void save_resident()
+{
+	if(!resident || resident_resets != heap_resets || !is_fresh(resident_frame) || shared->heap_used > Requests::max_saved_size)
+		return;
+
+	auto i = saved.find(resident_key);
+
+	if(i != saved.end() && i->second.frame >= resident_frame)
+		return;
+
+	auto &result = saved[resident_key];
+
+	result.frame = resident_frame;
+	result.roots = shared->data;
+	result.heap_used = shared->heap_used;
+	result.heap.assign((char *)heap.start, (char *)heap.start + shared->heap_used);
+
+	saved_bytes += shared->heap_used;
+}
+
+static bool restore(uint64_t key)
+{
+	auto i = saved.find(key);
+
+	if(i == saved.end() || !is_fresh(i->second.frame))
+		return false;
+
+	auto &result = i->second;
+
+	shared->data = result.roots;
+	shared->heap_used = result.heap_used;
+
+	if(result.heap_used)
+		memcpy((void *)heap.start, &result.heap[0], result.heap_used);
+
+	make_resident(key, result.frame);
+
+	return true;
+}
+
+void Requests::init()
+{
+	if(initialized)
+		return;
+
+	InitializeCriticalSection(&lock);
+	InitializeConditionVariable(&changed);
+
+	initialized = true;
+}
+
+// Must be called with the lock held
+static void check_holder(DWORD self)
+{
+	if(std::find(holders.begin(), holders.end(), self) != holders.end())
+	{
+		LeaveCriticalSection(&lock);
+		error("A result must be released before the next request");
+	}
+}
+
+Error::Type Requests::acquire(Call::Type type, size_t num, bool *fresh)
+{
+	uint64_t key = ((uint64_t)type << 32) | num;
+	DWORD self = GetCurrentThreadId();
+
+	if(fresh)
+		*fresh = false;
+
+	EnterCriticalSection(&lock);
+
+	check_holder(self);
+
+	bool joined = false;
+
+	while(true)
+	{
+		if(!in_flight && is_resident(key))
+		{
+			if(joined || !holders.empty())
+				coalesced++;
+			else
+				resident_hits++;
+
+			break;
+		}
+
+		if(in_flight && in_flight_key == key)
+			joined = true;
+		else if(!in_flight && holders.empty())
+		{
+			if(restore(key))
+			{
+				restored_hits++;
+				break;
+			}
+
+			in_flight = true;
+			in_flight_key = key;
+			in_flight_thread = self;
+
+			uint64_t started = generation;
+
+			LeaveCriticalSection(&lock);
+
+			Error::Type result;
+
+			try
+			{
+				shared->data.num = num;
+
+				result = remote_call(type);
+			}
+			catch(...)
+			{
+				EnterCriticalSection(&lock);
+				in_flight = false;
+				resident = false;
+				LeaveCriticalSection(&lock);
+				WakeAllConditionVariable(&changed);
+				throw;
+			}
+
+			EnterCriticalSection(&lock);
+
+			in_flight = false;
+			calls++;
+
+			if(result != Error::None)
+			{
+				resident = false;
+				LeaveCriticalSection(&lock);
+				WakeAllConditionVariable(&changed);
+				return result;
+			}
+
+			make_resident(key, frame);
+
+			// The result is still returned to this thread, but later requests make a new call
+			if(generation != started)
+				resident = false;
+
+			if(fresh)
+				*fresh = true;
+
+			WakeAllConditionVariable(&changed);
+
+			break;
+		}
+
+		// The holders wait for their tasks, so they won't release while a task waits here
+		if(!holders.empty() && std::find(tasks.begin(), tasks.end(), self) != tasks.end())
+		{
+			LeaveCriticalSection(&lock);
+			error("A module can only request the snapshot held for it");
+		}
+
+		SleepConditionVariableCS(&changed, &lock, INFINITE);
+	}
+
+	holders.push_back(self);
+
+	LeaveCriticalSection(&lock);
+
+	return Error::None;
+}
+
+void Requests::enter_task()
+{
+	EnterCriticalSection(&lock);
+
+	tasks.push_back(GetCurrentThreadId());
+
+	LeaveCriticalSection(&lock);
+}
+
+void Requests::leave_task()
+{
+	EnterCriticalSection(&lock);
+
+	auto i = std::find(tasks.begin(), tasks.end(), GetCurrentThreadId());
+
+	if(i != tasks.end())
+		tasks.erase(i);
+
+	LeaveCriticalSection(&lock);
+}
+
+void Requests::hold()
+{
+	DWORD self = GetCurrentThreadId();
+
+	EnterCriticalSection(&lock);
+
+	check_holder(self);
+
+	holders.push_back(self);
+
+	LeaveCriticalSection(&lock);
+}
+
+void Requests::release()
+{
+	EnterCriticalSection(&lock);
+
+	auto i = std::find(holders.begin(), holders.end(), GetCurrentThreadId());
+
+	if(i != holders.end())
+		holders.erase(i);
+
+	bool idle = holders.empty();
+
+	LeaveCriticalSection(&lock);
+
+	if(idle)
+		WakeAllConditionVariable(&changed);
+}
+
+bool Requests::held()
+{
+	EnterCriticalSection(&lock);
+
+	bool result = !holders.empty();
+
+	LeaveCriticalSection(&lock);
+
+	return result;
+}
+
+bool Requests::begin_call()
+{
+	DWORD self = GetCurrentThreadId();
+
+	EnterCriticalSection(&lock);
+
+	if(in_flight && in_flight_thread == self)
+	{
+		LeaveCriticalSection(&lock);
+		return false;
+	}
+
+	// Calls reset the heap, so one made by another thread must finish first
+	while(in_flight)
+		SleepConditionVariableCS(&changed, &lock, INFINITE);
+
+	if(!holders.empty())
+	{
+		LeaveCriticalSection(&lock);
+		error("A snapshot must be released before the next remote call");
+	}
+
+	in_flight = true;
+	in_flight_key = direct_key;
+	in_flight_thread = self;
+
+	LeaveCriticalSection(&lock);
+
+	return true;
+}
+
+void Requests::end_call()
+{
+	EnterCriticalSection(&lock);
+
+	in_flight = false;
+
+	LeaveCriticalSection(&lock);
+
+	WakeAllConditionVariable(&changed);
+}
+
+void Requests::before_reset(Call::Type type)
+{
+	EnterCriticalSection(&lock);
+
+	// Continue starts the next frame, so the result must still be fresh in that one to be worth saving
+	if(type != Call::Continue || frame + 1 - resident_frame <= ttl)
+		save_resident();
+
+	LeaveCriticalSection(&lock);
+}
+
+void Requests::next_frame()
+{
+	EnterCriticalSection(&lock);
+
+	frame++;
+
+	for(auto i = saved.begin(); i != saved.end();)
+	{
+		if(is_fresh(i->second.frame))
+			++i;
+		else
+			i = saved.erase(i);
+	}
+
+	LeaveCriticalSection(&lock);
+}
+
+void Requests::invalidate()
+{
+	EnterCriticalSection(&lock);
+
+	generation++;
+	resident = false;
+	saved.clear();
+
+	LeaveCriticalSection(&lock);
+}
+
+void Requests::report()
+{
+	EnterCriticalSection(&lock);
+
+	uint64_t requests = calls + resident_hits + restored_hits + coalesced;
+
+	printf("Requests: %llu served by %llu remote calls (%llu resident hits, %llu restored, %llu coalesced), %.1f KB saved\n",
+		requests, calls, resident_hits, restored_hits, coalesced, saved_bytes / 1024.0);
+
+	LeaveCriticalSection(&lock);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "shade.hpp"
+
+namespace Shade
+{
+	/*
+		Shares the results of remote calls between consumers. A result is identified by the call and its
+		argument in Shared::data.num. While a result is held, it stays in the shared mapping, and other
+		requests for the same call are served from it without a remote call. Requests for the same call
+		made while it's in flight wait for it instead of calling again.
+		Results are fresh for 'ttl' frames after the one they were made in. When another call is about to
+		reset the heap, a fresh result is copied to the host so a later request can restore it.
+	*/
+	namespace Requests
+	{
+		static const size_t max_saved_size = 0x800000;
+
+		extern size_t ttl;
+
+		// Sets up the lock. Can be called again.
+		void init();
+
+		/*
+			Makes the result of 'type' called with 'num' resident in the shared mapping and holds it until release.
+			A thread can only hold one result. Other threads requesting a different result wait for it to be released.
+			'fresh' is set if a remote call was made.
+		*/
+		Error::Type acquire(Call::Type type, size_t num = 0, bool *fresh = 0);
+
+		/*
+			Marks the calling thread as running work for a thread holding a result, like a bot module.
+			The holder waits for it, so its requests for other results fail instead of waiting for the release.
+		*/
+		void enter_task();
+		void leave_task();
+
+		// Holds the contents of the shared mapping without a request, used for snapshots loaded by a replay
+		void hold();
+
+		void release();
+
+		// Returns true while any thread holds a result. Remote calls reset the heap, so they aren't allowed then.
+		bool held();
+
+		/*
+			Called by remote_call. Waits for a call made by another thread and fails if a result is held.
+			Returns false for the call of a request, which is already in flight, otherwise end_call must follow.
+		*/
+		bool begin_call();
+		void end_call();
+
+		// Called by remote_call before the remote tick resets the heap. Saves the resident result if it stays fresh.
+		void before_reset(Call::Type type);
+
+		// Called once for each tick of the remote process
+		void next_frame();
+
+		/*
+			Drops the resident and saved results after a change which affects what remote calls return,
+			like a new actor filter. A result in flight when this is called isn't kept either.
+		*/
+		void invalidate();
+
+		void report();
+	};
+};
@@ -0,0 +1,546 @@
+#include "scanner.hpp"
+#include "cache.hpp"
+#include <tlhelp32.h>
+#include <emmintrin.h>
+#include <intrin.h>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+
+/*
+	Patterns for each symbol can be added here or in signatures.txt using the format:
+		<name> <match|absolute|relative> <operand offset> <pattern>
+	Symbols without a pattern use the address from 1.0.3.10235.
+*/
+static Shade::Signature signatures[] = {
+	{Shade::Symbol::UIReferenceList, "ui_reference_list", 0x158E3B8, Shade::Signature::Absolute, 0, ""},
+	{Shade::Symbol::AttributeList, "attribute_list", 0x157E518, Shade::Signature::Absolute, 0, ""},
+	{Shade::Symbol::UIHandlerList, "ui_handler_list", 0x15924E0, Shade::Signature::Absolute, 0, ""},
+	{Shade::Symbol::ObjectManager, "object_manager", 0x15A1BEC, Shade::Signature::Absolute, 0, ""},
+	{Shade::Symbol::WindowNotMinimized, "window_not_minimized", 0x157D2AC, Shade::Signature::Absolute, 0, ""},
+	{Shade::Symbol::GameData, "game_data", 0x15A2EA4, Shade::Signature::Absolute, 0, ""},
+	{Shade::Symbol::IterateActorObjects, "iterate_actor_objects", 0x9E58B0, Shade::Signature::Match, 0, ""},
+	{Shade::Symbol::GetUIComponent, "get_ui_component", 0x93F400, Shade::Signature::Match, 0, ""},
+	{Shade::Symbol::ExtractUIRect, "extract_ui_rect", 0xA85B80, Shade::Signature::Match, 0, ""},
+	{Shade::Symbol::MapUIRect, "map_ui_rect", 0xA8A230, Shade::Signature::Match, 0, ""}
+};
+
+static_assert(sizeof(signatures) / sizeof(Shade::Signature) == Shade::Symbol::Count, "Missing signatures");
+
+static const size_t header_size = 0x1000;
+
+size_t Shade::module_delta;
+
+// Bytes which are very common in x86 code and make poor candidates for the first comparison
+static bool common_byte(uint8_t byte)
+{
+	switch(byte)
+	{
+		case 0x00: case 0x01: case 0x04: case 0x08: case 0x0F: case 0x10:
+		case 0x24: case 0x44: case 0x45: case 0x4D: case 0x50: case 0x51:
+		case 0x52: case 0x53: case 0x55: case 0x56: case 0x57: case 0x74:
+		case 0x75: case 0x83: case 0x85: case 0x89: case 0x8B: case 0x8D:
+		case 0xC0: case 0xC3: case 0xCC: case 0xE8: case 0xFF:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+Shade::Pattern::Pattern(const std::string &pattern) : first((size_t)-1), last((size_t)-1)
+{
+	std::istringstream in(pattern);
+	std::string token;
+
+	while(in >> token)
+	{
+		if(token == "?" || token == "??")
+		{
+			bytes.push_back(0);
+			mask.push_back(0);
+			continue;
+		}
+
+		char *end;
+		unsigned long value = strtoul(token.c_str(), &end, 16);
+
+		if(*end || token.size() > 2)
+			error("Invalid byte '" + token + "' in pattern '" + pattern + "'");
+
+		if(first == (size_t)-1 || (common_byte(bytes[first]) && !common_byte((uint8_t)value)))
+			first = bytes.size();
+
+		last = bytes.size();
+
+		bytes.push_back((uint8_t)value);
+		mask.push_back(0xFF);
+	}
+
+	if(last == (size_t)-1)
+		error("Pattern '" + pattern + "' has no fixed bytes");
+}
+
+static bool verify(const uint8_t *data, const Shade::Pattern &pattern)
+{
+	for(size_t i = 0; i < pattern.bytes.size(); ++i)
+		if((data[i] & pattern.mask[i]) != pattern.bytes[i])
+			return false;
+
+	return true;
+}
+
+/*
+	Returns the first position in [start, end) where the pattern matches.
+	The bytes at 'first' and 'last' are compared for 16 positions at a time and only
+	positions where both match are verified against the full pattern.
+*/
+static size_t scan_range(const uint8_t *image, size_t start, size_t end, const Shade::Pattern &pattern)
+{
+	__m128i first = _mm_set1_epi8((char)pattern.bytes[pattern.first]);
+	__m128i last = _mm_set1_epi8((char)pattern.bytes[pattern.last]);
+
+	size_t pos = start;
+
+	for(; pos + 16 <= end; pos += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(image + pos + pattern.first));
+		__m128i b = _mm_loadu_si128((const __m128i *)(image + pos + pattern.last));
+
+		unsigned long candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+		while(candidates)
+		{
+			unsigned long bit;
+
+			_BitScanForward(&bit, candidates);
+
+			if(verify(image + pos + bit, pattern))
+				return pos + bit;
+
+			candidates &= candidates - 1;
+		}
+	}
+
+	for(; pos < end; ++pos)
+		if(verify(image + pos, pattern))
+			return pos;
+
+	return (size_t)-1;
+}
+
+void Shade::scan(const uint8_t *image, size_t size, const std::vector<Pattern *> &patterns, std::vector<size_t> &results)
+{
+	const size_t chunk_size = 0x10000;
+
+	results.assign(patterns.size(), (size_t)-1);
+
+	size_t remaining = patterns.size();
+
+	for(size_t chunk = 0; chunk < size && remaining; chunk += chunk_size)
+	{
+		for(size_t i = 0; i < patterns.size(); ++i)
+		{
+			Pattern &pattern = *patterns[i];
+
+			if(results[i] != (size_t)-1 || pattern.bytes.size() > size)
+				continue;
+
+			// Matches may start in this chunk and extend into the next one
+			size_t end = std::min(chunk + chunk_size, size - pattern.bytes.size() + 1);
+
+			if(chunk >= end)
+				continue;
+
+			size_t found = scan_range(image, chunk, end, pattern);
+
+			if(found != (size_t)-1)
+			{
+				results[i] = found;
+				remaining--;
+			}
+		}
+	}
+}
+
+static Shade::Signature::Kind parse_kind(const std::string &kind)
+{
+	if(kind == "match")
+		return Shade::Signature::Match;
+	else if(kind == "absolute")
+		return Shade::Signature::Absolute;
+	else if(kind == "relative")
+		return Shade::Signature::Relative;
+
+	Shade::error("Unknown signature kind '" + kind + "'");
+}
+
+static void load_signatures()
+{
+	std::ifstream file("signatures.txt");
+	std::string line;
+
+	while(std::getline(file, line))
+	{
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream in(line);
+		std::string name, kind;
+		size_t operand;
+
+		if(!(in >> name >> kind >> operand))
+			Shade::error("Invalid line in signatures.txt: " + line);
+
+		std::string pattern;
+		std::getline(in, pattern);
+
+		size_t i = 0;
+
+		for(; i < Shade::Symbol::Count; ++i)
+		{
+			if(name == signatures[i].name)
+			{
+				signatures[i].kind = parse_kind(kind);
+				signatures[i].operand = operand;
+				signatures[i].pattern = pattern;
+				break;
+			}
+		}
+
+		if(i == Shade::Symbol::Count)
+			Shade::error("Unknown symbol '" + name + "' in signatures.txt");
+	}
+}
+
+static uint64_t hash(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+// The module hash covers the PE headers (timestamp, checksum and section layout) and the signature table
+static uint64_t module_hash(const uint8_t *headers)
+{
+	uint64_t result = hash(0xCBF29CE484222325ull, headers, header_size);
+
+	for(size_t i = 0; i < Shade::Symbol::Count; ++i)
+	{
+		auto &signature = signatures[i];
+
+		result = hash(result, &signature.kind, sizeof(signature.kind));
+		result = hash(result, &signature.operand, sizeof(signature.operand));
+		result = hash(result, signature.pattern.c_str(), signature.pattern.size() + 1);
+	}
+
+	return result;
+}
+
+static bool load_cache(uint64_t key)
+{
+	std::ifstream file("symbols.cache");
+
+	uint64_t cached_key;
+
+	if(!(file >> std::hex >> cached_key) || cached_key != key)
+		return false;
+
+	size_t symbols[Shade::Symbol::Count];
+
+	for(size_t i = 0; i < Shade::Symbol::Count; ++i)
+	{
+		std::string name;
+
+		if(!(file >> name >> std::hex >> symbols[i]) || name != signatures[i].name)
+			return false;
+	}
+
+	memcpy(Shade::shared->symbols, symbols, sizeof(symbols));
+
+	return true;
+}
+
+static void save_cache(uint64_t key)
+{
+	std::ofstream file("symbols.cache");
+
+	file << std::hex << key << "\n";
+
+	for(size_t i = 0; i < Shade::Symbol::Count; ++i)
+		file << signatures[i].name << " " << Shade::shared->symbols[i] << "\n";
+}
+
+static void read_image(uint8_t *base, uint8_t *image, size_t size)
+{
+	memset(image, 0, size);
+
+	size_t offset = 0;
+
+	while(offset < size)
+	{
+		MEMORY_BASIC_INFORMATION info;
+
+		if(!VirtualQueryEx(Shade::process, base + offset, &info, sizeof(info)))
+			Shade::win32_error("Unable to query remote memory");
+
+		size_t region = std::min(info.RegionSize - (size_t)(base + offset - (uint8_t *)info.BaseAddress), size - offset);
+
+		// Unreadable regions are left as zeroes
+		if(info.State == MEM_COMMIT && !(info.Protect & (PAGE_NOACCESS | PAGE_GUARD)))
+			ReadProcessMemory(Shade::process, base + offset, image + offset, region, 0);
+
+		offset += region;
+	}
+}
+
+// Sections of the module which aren't writable don't change, so they can stay in the read cache
+static void set_cache_policy(uint8_t *base, const uint8_t *headers)
+{
+	auto dos = (const IMAGE_DOS_HEADER *)headers;
+
+	if(dos->e_magic != IMAGE_DOS_SIGNATURE || (size_t)dos->e_lfanew > header_size - sizeof(IMAGE_NT_HEADERS))
+		return;
+
+	auto nt = (const IMAGE_NT_HEADERS *)(headers + dos->e_lfanew);
+	auto section = IMAGE_FIRST_SECTION(nt);
+
+	for(WORD i = 0; i < nt->FileHeader.NumberOfSections && (const uint8_t *)(section + 1) <= headers + header_size; ++i, ++section)
+	{
+		if(!(section->Characteristics & IMAGE_SCN_MEM_WRITE))
+			Shade::ReadCache::set_policy(base + section->VirtualAddress, section->Misc.VirtualSize, Shade::ReadCache::Static);
+	}
+}
+
+void Shade::resolve_symbols()
+{
+	LARGE_INTEGER frequency, start, stop;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	load_signatures();
+
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetProcessId(process));
+
+	if(snapshot == INVALID_HANDLE_VALUE)
+		win32_error("Unable to list remote modules");
+
+	MODULEENTRY32W module;
+	module.dwSize = sizeof(module);
+
+	if(!Module32FirstW(snapshot, &module))
+	{
+		CloseHandle(snapshot);
+		win32_error("Unable to find the remote main module");
+	}
+
+	CloseHandle(snapshot);
+
+	uint8_t *base = module.modBaseAddr;
+	size_t size = module.modBaseSize;
+
+	module_delta = (size_t)base - Symbol::image_base;
+
+	uint8_t headers[header_size];
+
+	read(base, headers, header_size);
+
+	set_cache_policy(base, headers);
+
+	uint64_t key = module_hash(headers);
+
+	if(load_cache(key))
+	{
+		printf("Loaded symbols from cache\n");
+		return;
+	}
+
+	std::vector<Pattern *> patterns;
+	std::vector<size_t> indices;
+
+	for(size_t i = 0; i < Symbol::Count; ++i)
+	{
+		shared->symbols[i] = signatures[i].fallback;
+
+		if(!signatures[i].pattern.empty())
+		{
+			patterns.push_back(new Pattern(signatures[i].pattern));
+			indices.push_back(i);
+		}
+	}
+
+	size_t found = 0;
+
+	if(!patterns.empty())
+	{
+		std::vector<uint8_t> image(size);
+		std::vector<size_t> results;
+
+		read_image(base, &image[0], size);
+		scan(&image[0], size, patterns, results);
+
+		for(size_t i = 0; i < patterns.size(); ++i)
+		{
+			auto &signature = signatures[indices[i]];
+			size_t match = results[i];
+
+			delete patterns[i];
+
+			if(match == (size_t)-1 || match + signature.operand + 4 > size)
+			{
+				printf("Signature for %s not found, using 1.0.3.10235 address\n", signature.name);
+				continue;
+			}
+
+			size_t address;
+			uint32_t operand = *(uint32_t *)&image[match + signature.operand];
+
+			switch(signature.kind)
+			{
+				case Signature::Match:
+					address = match;
+					break;
+
+				case Signature::Absolute:
+					address = operand - (size_t)base;
+					break;
+
+				case Signature::Relative:
+					address = match + signature.operand + 4 + (int32_t)operand;
+					break;
+			}
+
+			if(address >= size)
+			{
+				printf("Signature for %s resolved outside the module, using 1.0.3.10235 address\n", signature.name);
+				continue;
+			}
+
+			shared->symbols[indices[i]] = address + Symbol::image_base;
+			found++;
+		}
+	}
+
+	save_cache(key);
+
+	QueryPerformanceCounter(&stop);
+
+	double ms = (double)(stop.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+
+	printf("Resolved %u of %u symbols by signature, scanned %.1f MB in %.2f ms\n", (unsigned)found, (unsigned)Symbol::Count, patterns.empty() ? 0.0 : size / (1024.0 * 1024.0), ms);
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_scan_benchmark(size_t size, size_t count)
+{
+	return Shade::wrap([&] {
+		const size_t length = 16;
+
+		if(size < 0x20000 || count < 3)
+			Shade::error("The scan benchmark needs an image of at least 128 KB and 3 patterns");
+
+		uint32_t state = 0x2545F491;
+
+		auto random = [&]() -> uint32_t {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		};
+
+		// Half of the image is common x86 bytes so the candidate filter sees realistic hit rates
+		static const uint8_t common[] = {0x00, 0x8B, 0x89, 0xE8, 0xFF, 0x83, 0x85, 0x0F, 0x74, 0x75, 0x50, 0xC3, 0xCC, 0x8D, 0x24, 0x44};
+
+		std::vector<uint8_t> image(size);
+
+		for(size_t i = 0; i < size; ++i)
+			image[i] = (random() & 1) ? common[random() % sizeof(common)] : (uint8_t)random();
+
+		std::vector<Shade::Pattern *> patterns;
+
+		auto cleanup = [&] {
+			for(size_t i = 0; i < patterns.size(); ++i)
+				delete patterns[i];
+		};
+
+		try
+		{
+			for(size_t i = 0; i < count; ++i)
+			{
+				std::ostringstream pattern;
+
+				for(size_t j = 0; j < length; ++j)
+				{
+					if(j != 0 && j != length - 1 && random() % 4 == 0)
+						pattern << "? ";
+					else
+						pattern << std::hex << (unsigned)common[random() % sizeof(common)] << " ";
+				}
+
+				patterns.push_back(new Shade::Pattern(pattern.str()));
+
+				/*
+					The first pattern straddles the first chunk boundary, the second ends at the end of the image
+					and the last isn't planted at all.
+				*/
+				if(i == count - 1)
+					continue;
+
+				size_t offset = i == 0 ? 0x10000 - length / 2 : i == 1 ? size - length : random() % (size - length);
+
+				for(size_t j = 0; j < length; ++j)
+					if(patterns[i]->mask[j])
+						image[offset + j] = patterns[i]->bytes[j];
+			}
+
+			LARGE_INTEGER frequency, start, stop;
+
+			QueryPerformanceFrequency(&frequency);
+			QueryPerformanceCounter(&start);
+
+			std::vector<size_t> results;
+
+			Shade::scan(&image[0], size, patterns, results);
+
+			QueryPerformanceCounter(&stop);
+
+			for(size_t i = 0; i < count; ++i)
+			{
+				size_t expected = (size_t)-1;
+
+				for(size_t pos = 0; pos + length <= size; ++pos)
+				{
+					if(verify(&image[pos], *patterns[i]))
+					{
+						expected = pos;
+						break;
+					}
+				}
+
+				if(results[i] != expected)
+				{
+					std::ostringstream message;
+					message << "Pattern " << i << " was found at " << (ptrdiff_t)results[i] << " instead of " << (ptrdiff_t)expected;
+					Shade::error(message.str());
+				}
+			}
+
+			double ms = (double)(stop.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+
+			printf("Scanned %.1f MB for %u patterns in %.2f ms (%.0f MB/s)\n", size / (1024.0 * 1024.0), (unsigned)count, ms, size / (1024.0 * 1024.0) / (ms / 1000.0));
+		}
+		catch(...)
+		{
+			cleanup();
+			throw;
+		}
+
+		cleanup();
+	});
+}
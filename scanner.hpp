@@ -0,0 +1,51 @@
+#pragma once
+#include "shade.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace Shade
+{
+	struct Pattern
+	{
+		std::vector<uint8_t> bytes;
+		std::vector<uint8_t> mask; // 0xFF for bytes which must match, 0 for wildcards
+		size_t first; // Index of the rarest fixed byte, compared first
+		size_t last; // Index of the last fixed byte
+
+		/*
+			Parses an IDA style pattern like "8B 0D ? ? ? ? 85 C9".
+			Both '?' and '??' are wildcards.
+		*/
+		Pattern(const std::string &pattern);
+	};
+
+	struct Signature
+	{
+		enum Kind
+		{
+			Match, // The symbol is at the match
+			Absolute, // A 32-bit absolute address of the symbol is stored at the operand
+			Relative // A 32-bit displacement relative to the end of the operand is stored at the operand (call/jmp)
+		};
+
+		Symbol::Type symbol;
+		const char *name;
+		size_t fallback; // Address in 1.0.3.10235
+		Kind kind;
+		size_t operand; // Offset from the start of the match to the operand
+		std::string pattern; // Empty if the symbol is only resolved by the fallback
+	};
+
+	/*
+		Scans 'size' bytes at 'image' for each pattern in a single pass over the image.
+		The image is processed in cache sized chunks and every pattern is matched against a chunk
+		before moving on, so the image is only streamed from memory once.
+		Returns the offset of the first match for each pattern or (size_t)-1 if it wasn't found.
+	*/
+	void scan(const uint8_t *image, size_t size, const std::vector<Pattern *> &patterns, std::vector<size_t> &results);
+
+	// Difference between the base of the remote main module and Symbol::image_base
+	extern size_t module_delta;
+
+	void resolve_symbols();
+};
@@ -1,24 +1,189 @@
 #include "shade.hpp"
 #include "process.hpp"
 #include "d3d.hpp"
+#include "scanner.hpp"
+#include "profile.hpp"
+#include "reader.hpp"
+#include "cache.hpp"
+#include "query.hpp"
+#include "names.hpp"
+#include "log.hpp"
+#include "requests.hpp"
+#include "recorder.hpp"
 #include "compiler/compiler.hpp"
 #include "compiler/disassembler.hpp"
 
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 
 void Shade::write(void *remote, const void *local, size_t size)
 {
+	ReadCache::invalidate(remote, size);
+
 	if(!WriteProcessMemory(process, remote, local, size, 0))
 		win32_error("Unable to write remote memory");
 }
 
 void Shade::read(const void *remote, void *local, size_t size)
 {
+	if(ReadCache::read(remote, local, size))
+		return;
+
 	if(!ReadProcessMemory(process, remote, local, size, 0))
 		win32_error("Unable to read remote memory");
 }
 
+// Returns the transfer indices sorted by remote address, keeping list order for transfers starting at the same address
+static std::vector<size_t> sort_transfers(std::vector<Shade::Transfer> &transfers)
+{
+	std::vector<size_t> order(transfers.size());
+
+	for(size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return transfers[a].remote < transfers[b].remote;
+	});
+
+	return order;
+}
+
+/*
+	Calls 'func' with each run of transfers whose remote ranges are adjacent or overlap.
+	'func' gets the run as a range of sorted indices and the remote range it covers.
+*/
+template<class F> static void each_run(std::vector<Shade::Transfer> &transfers, F func)
+{
+	auto order = sort_transfers(transfers);
+
+	for(size_t i = 0; i < order.size();)
+	{
+		char *start = (char *)transfers[order[i]].remote;
+		char *end = start + transfers[order[i]].size;
+		size_t next = i + 1;
+
+		while(next < order.size() && (char *)transfers[order[next]].remote <= end)
+		{
+			auto &transfer = transfers[order[next++]];
+
+			end = std::max(end, (char *)transfer.remote + transfer.size);
+		}
+
+		func(&order[i], &order[next - 1] + 1, start, (size_t)(end - start));
+
+		i = next;
+	}
+}
+
+size_t Shade::read_batch(std::vector<Transfer> &transfers)
+{
+	size_t failed = 0;
+	std::vector<char> staging;
+
+	each_run(transfers, [&](size_t *begin, size_t *end, char *start, size_t size) {
+		if(end - begin == 1)
+		{
+			auto &transfer = transfers[*begin];
+
+			transfer.done = ReadProcessMemory(process, transfer.remote, transfer.local, transfer.size, 0) != 0;
+		}
+		else
+		{
+			staging.resize(size);
+
+			bool done = ReadProcessMemory(process, start, &staging[0], size, 0) != 0;
+
+			for(auto i = begin; i != end; ++i)
+			{
+				auto &transfer = transfers[*i];
+
+				if(done)
+					memcpy(transfer.local, &staging[(char *)transfer.remote - start], transfer.size);
+
+				transfer.done = done || ReadProcessMemory(process, transfer.remote, transfer.local, transfer.size, 0);
+			}
+		}
+
+		for(auto i = begin; i != end; ++i)
+			if(!transfers[*i].done)
+				failed++;
+	});
+
+	return failed;
+}
+
+size_t Shade::write_batch(std::vector<Transfer> &transfers)
+{
+	size_t failed = 0;
+	std::vector<char> staging;
+
+	each_run(transfers, [&](size_t *begin, size_t *end, char *start, size_t size) {
+		ReadCache::invalidate(start, size);
+
+		if(end - begin == 1)
+		{
+			auto &transfer = transfers[*begin];
+
+			transfer.done = WriteProcessMemory(process, transfer.remote, transfer.local, transfer.size, 0) != 0;
+		}
+		else
+		{
+			// Apply overlapping writes in list order
+			std::sort(begin, end);
+
+			staging.resize(size);
+
+			for(auto i = begin; i != end; ++i)
+			{
+				auto &transfer = transfers[*i];
+
+				memcpy(&staging[(char *)transfer.remote - start], transfer.local, transfer.size);
+			}
+
+			bool done = WriteProcessMemory(process, start, &staging[0], size, 0) != 0;
+
+			for(auto i = begin; i != end; ++i)
+			{
+				auto &transfer = transfers[*i];
+
+				transfer.done = done || WriteProcessMemory(process, transfer.remote, transfer.local, transfer.size, 0);
+			}
+		}
+
+		for(auto i = begin; i != end; ++i)
+			if(!transfers[*i].done)
+				failed++;
+	});
+
+	return failed;
+}
+
+void Shade::WriteQueue::add(void *remote, const void *local, size_t size)
+{
+	Transfer transfer = {remote, (void *)data.size(), size, false};
+
+	data.insert(data.end(), (const char *)local, (const char *)local + size);
+	transfers.push_back(transfer);
+}
+
+void Shade::WriteQueue::flush()
+{
+	if(transfers.empty())
+		return;
+
+	for(auto transfer = transfers.begin(); transfer != transfers.end(); ++transfer)
+		transfer->local = &data[(size_t)transfer->local];
+
+	size_t failed = write_batch(transfers);
+
+	transfers.clear();
+	data.clear();
+
+	if(failed)
+		win32_error("Unable to write remote memory");
+}
+
 std::string Shade::win32_error_code(DWORD err_no)
 {
 	char *msg_buffer;
@@ -59,6 +224,22 @@ extern "C" D3C_EXPORT void D3C_API d3c_free_error(d3c_error_t error)
 	delete error;
 }
 
+static size_t remote_workers = (size_t)-1;
+
+static void set_remote_workers()
+{
+	if(remote_workers == (size_t)-1)
+	{
+		SYSTEM_INFO info;
+
+		GetSystemInfo(&info);
+
+		remote_workers = info.dwNumberOfProcessors - 1;
+	}
+
+	Shade::shared->workers = remote_workers < Shade::Shared::max_workers ? remote_workers : Shade::Shared::max_workers;
+}
+
 void Shade::init()
 {
 	get_debug_privileges();
@@ -66,28 +247,69 @@ void Shade::init()
 	find_process();
 	//create_process();
 	allocate_shared_memory();
+	Log::start("shade.log");
+	set_remote_workers();
+	Requests::init();
 	get_preset_offset();
+	resolve_symbols();
+	Layout::load_profile();
 
 	init_disassembler();
 	compile_module();
 
 	resume_process();
+
+	ReadCache::enable(0x400);
 }
 
-Shade::Error::Type Shade::remote_call(Call::Type type)
+size_t Shade::heap_resets;
+
+static double remote_call_time;
+static size_t remote_call_count;
+
+double Shade::avg_time_per_remote_call()
 {
+	return remote_call_count ? remote_call_time / remote_call_count : 0.0;
+}
+
+static Shade::Error::Type call(Shade::Call::Type type)
+{
+	using namespace Shade;
+
+	LARGE_INTEGER start, stop;
+
+	QueryPerformanceCounter(&start);
+
+	// The remote tick resets the heap before every call, including Continue
+	Requests::before_reset(type);
+
 	shared->error_type = Error::None;
 	shared->call_type = type;
 
+	heap_resets++;
+
 	MemoryBarrier();
 
 	signal_event(local.end);
 	wait_event(local.start);
-	reset_event(local.start);
 	
 	if(type == Call::Continue)
 		return Error::None;
 
+	QueryPerformanceCounter(&stop);
+
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceFrequency(&frequency);
+
+	// Continue waits for the next tick, so only other calls are timed
+	double time = (double)(stop.QuadPart - start.QuadPart) * 1000000.0 / frequency.QuadPart;
+
+	remote_call_time += time;
+	remote_call_count++;
+
+	Log::write(Log::RemoteCallTime, type, (uint32_t)time);
+
 	if(shared->error_type == Error::OutOfMemory)
 	{
 		TerminateProcess(process, 1);
@@ -98,6 +320,42 @@ Shade::Error::Type Shade::remote_call(Call::Type type)
 	return shared->error_type;
 }
 
+Shade::Error::Type Shade::remote_call(Call::Type type)
+{
+	if(Recorder::replaying)
+		error("Remote calls can't be made during a replay");
+
+	bool direct = Requests::begin_call();
+
+	Error::Type result;
+
+	try
+	{
+		result = call(type);
+	}
+	catch(...)
+	{
+		if(direct)
+			Requests::end_call();
+
+		throw;
+	}
+
+	if(direct)
+		Requests::end_call();
+
+	return result;
+}
+
+namespace Shade
+{
+	SHADE_ROW_DESCRIBE(UIHandler, SHADE_SCHEMA_UI_HANDLER)
+	SHADE_ROW_DESCRIBE(Actor, SHADE_SCHEMA_ACTOR)
+	SHADE_ROW_DESCRIBE(ActorCommonData, SHADE_SCHEMA_ACTOR_COMMON_DATA)
+	SHADE_RECORD_DESCRIBE(Actor, SHADE_SCHEMA_ACTOR)
+	SHADE_RECORD_DESCRIBE(ActorCommonData, SHADE_SCHEMA_ACTOR_COMMON_DATA)
+};
+
 static bool write_ui = false;
 
 static void list_element(Shade::Remote::UIElement *element, std::ofstream &fs, std::ofstream &fsv)
@@ -133,12 +391,17 @@ void Shade::loop(d3c_tick_t tick_func)
 	while(true)
 	{
 		remote_call(Call::Continue);
+
+		// The game has run another tick, so data read before is out of date
+		ReadCache::next_epoch();
+		Requests::next_frame();
+		names.next_epoch();
 		
 		if(!write_ui)
 		{
 			write_ui = true;
 
-			printf("Listing UI\n");
+			Log::write(Log::Listing, Call::ListUI);
 
 			auto call_error = remote_call(Call::ListUI);
 
@@ -155,7 +418,7 @@ void Shade::loop(d3c_tick_t tick_func)
 				fsv.close();
 			}
 
-			printf("Listing UI Handlers\n");
+			Log::write(Log::Listing, Call::ListUIHandlers);
 
 			call_error = remote_call(Call::ListUIHandlers);
 
@@ -166,13 +429,13 @@ void Shade::loop(d3c_tick_t tick_func)
 				
 				for(auto i = shared->data.ui_handlers->begin(); i != shared->data.ui_handlers->end(); ++i)
 				{
-					fs << "UIHandler " << "\n\t Hash: " << i().hash << "\n\t Name: " << i().name->c_str() << "\n\t Function: " << i().func << "\n";
+					describe(fs, i());
 				}
 
 				fs.close();
 			}
 			
-			printf("Listing RActors Handlers\n");
+			Log::write(Log::Listing, Call::ListRActorAssets);
 
 			call_error = remote_call(Call::ListRActorAssets);
 
@@ -183,13 +446,32 @@ void Shade::loop(d3c_tick_t tick_func)
 				
 				for(auto i = shared->data.actors->begin(); i != shared->data.actors->end(); ++i)
 				{
-					fs << "Actor " << "\n\t Ptr: " << i().ptr << "\n\t Id: " << i().id << "\n\t AcdId: " << i().acd_id << "\n\t Name: " << i().name->c_str() << "\n";
+					describe(fs, i());
 				}
 
 				fs.close();
+
+				Query::Table table;
+				Query::Selection selection;
+				std::vector<Query::Group> groups;
+
+				Query::load_actors(table);
+
+				LARGE_INTEGER frequency, start, stop;
+
+				QueryPerformanceFrequency(&frequency);
+				QueryPerformanceCounter(&start);
+
+				Query::filter(table, "id", Query::NotEqual, -1, selection);
+				Query::group(table, "world_id", "", selection, groups);
+
+				QueryPerformanceCounter(&stop);
+
+				Log::write(Log::ActorsGrouped, selection.size(), table.rows, groups.size(), (uint32_t)((stop.QuadPart - start.QuadPart) * 1000000000 / frequency.QuadPart));
 			}
 
-			printf("Listing ActorCommonData Handlers\n");
+			Log::write(Log::Listing, Call::ListCommonDataAssets);
+
 			call_error = remote_call(Call::ListCommonDataAssets);
 
 			if(call_error == Error::None)
@@ -199,12 +481,45 @@ void Shade::loop(d3c_tick_t tick_func)
 				
 				for(auto i = shared->data.acds->begin(); i != shared->data.acds->end(); ++i)
 				{
-					fs << "ACD " << "\n\t Ptr: " << i().ptr << "\n\t Id: " << i().id << "\n\t OwnerId: " << i().owner_id << "\n\t Name: " << i().name->c_str() << "\n";
+					describe(fs, i());
 				}
 
 				fs.close();
 			}
 
+			printf("Reading RActors and ActorCommonData without remote calls\n");
+
+			std::vector<External::Actor> actors;
+
+			External::list_actors(actors);
+
+			std::ofstream fs;
+			fs.open("external-RActors.txt");
+
+			for(auto i = actors.begin(); i != actors.end(); ++i)
+			{
+				describe(fs, *i);
+			}
+
+			fs.close();
+
+			std::vector<External::ActorCommonData> acds;
+
+			External::list_acds(acds);
+
+			fs.open("external-ActorCommonData.txt");
+
+			for(auto i = acds.begin(); i != acds.end(); ++i)
+			{
+				describe(fs, *i);
+			}
+
+			fs.close();
+
+			ReadCache::report();
+			Requests::report();
+
+			printf("Average remote call: %.2f us\n", avg_time_per_remote_call());
 		}
 
 		tick_func();
@@ -213,9 +528,18 @@ void Shade::loop(d3c_tick_t tick_func)
 
 extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_loop(d3c_tick_t tick_func)
 {
-	return Shade::wrap([&] {
+	d3c_error_t result = Shade::wrap([&] {
 		Shade::loop(tick_func);
 	});
+
+	Shade::Log::stop();
+
+	return result;
+}
+
+extern "C" D3C_EXPORT void D3C_API d3c_set_remote_workers(size_t count)
+{
+	remote_workers = count;
 }
 
 extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_init()
@@ -11,6 +11,7 @@
 
 #include <cstdlib>
 #include <string>
+#include <vector>
 #include <Prelude/Internal/Common.hpp>
 
 #define D3C_EXPORTS
@@ -25,6 +26,34 @@ namespace Shade
 	
 	void write(void *remote, const void *local, size_t size);
 	void read(const void *remote, void *local, size_t size);
+
+	struct Transfer
+	{
+		void *remote;
+		void *local;
+		size_t size;
+		bool done; // Set by read_batch and write_batch
+	};
+
+	/*
+		Performs a list of transfers with as few calls as possible. Transfers with adjacent or overlapping
+		remote ranges are merged into a single call through a staging buffer. If a merged call fails, each
+		transfer in it is retried on its own so 'done' reports failures per transfer.
+		Overlapping writes are applied in list order. Returns the number of failed transfers.
+	*/
+	size_t read_batch(std::vector<Transfer> &transfers);
+	size_t write_batch(std::vector<Transfer> &transfers);
+
+	// Collects copies of data to be written and writes them all at once with write_batch
+	class WriteQueue
+	{
+		std::vector<char> data;
+		std::vector<Transfer> transfers; // 'local' is an offset into 'data' until flush
+
+	public:
+		void add(void *remote, const void *local, size_t size);
+		void flush();
+	};
 	
 	std::string win32_error_code(DWORD err_no);
 	prelude_noreturn void win32_error(DWORD err_no, std::string message);
@@ -59,7 +88,14 @@ namespace Shade
 		}
 	}
 	
+	extern size_t heap_resets; // Incremented whenever the contents of the shared heap are replaced
+
 	Error::Type remote_call(Call::Type type);
+
+	// Holds the snapshot for the tick until release_snapshot. During a replay this is the replayed snapshot.
+	void acquire_snapshot();
+	void release_snapshot();
+
 	void init();
 	void loop(d3c_tick_t tick_func);
 };
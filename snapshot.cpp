@@ -0,0 +1,230 @@
+#include "shade.hpp"
+#include "recorder.hpp"
+#include "names.hpp"
+#include "requests.hpp"
+#include <algorithm>
+
+using namespace Shade;
+
+/*
+	The opaque handles are the remote structures in the shared mapping.
+	Ptr offsets are relative to the start of the heap, which is set up for the host's view of the mapping.
+*/
+static Remote::Actor *actor(d3c_actor_t handle)
+{
+	return (Remote::Actor *)handle;
+}
+
+static Remote::ActorCommonData *acd(d3c_acd_t handle)
+{
+	return (Remote::ActorCommonData *)handle;
+}
+
+static Remote::UIElement *ui_node(d3c_ui_node_t handle)
+{
+	return (Remote::UIElement *)handle;
+}
+
+static const char *c_str(Ptr<String> &string)
+{
+	return string ? string->c_str() : 0;
+}
+
+void Shade::acquire_snapshot()
+{
+	// A replayed snapshot is already loaded into the mapping
+	if(Recorder::replaying)
+	{
+		Requests::hold();
+		return;
+	}
+
+	bool fresh;
+
+	// Consumers acquiring a snapshot in the same frame share it
+	if(Requests::acquire(Call::Snapshot, 0, &fresh) != Error::None)
+		error("Unable to take a snapshot");
+
+	if(fresh)
+		Recorder::record();
+}
+
+void Shade::release_snapshot()
+{
+	Requests::release();
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_snapshot_acquire(d3c_snapshot_t *snapshot)
+{
+	return Shade::wrap([&] {
+		acquire_snapshot();
+
+		*snapshot = (d3c_snapshot_t)&shared->data;
+	});
+}
+
+extern "C" D3C_EXPORT void D3C_API d3c_snapshot_release(d3c_snapshot_t snapshot)
+{
+	release_snapshot();
+}
+
+extern "C" D3C_EXPORT void D3C_API d3c_set_request_ttl(size_t frames)
+{
+	Requests::ttl = frames;
+}
+
+extern "C" D3C_EXPORT d3c_actor_t D3C_API d3c_first_actor(d3c_snapshot_t snapshot)
+{
+	return (d3c_actor_t)shared->data.actors->first.get();
+}
+
+extern "C" D3C_EXPORT d3c_actor_t D3C_API d3c_next_actor(d3c_actor_t handle)
+{
+	return (d3c_actor_t)actor(handle)->next.get();
+}
+
+extern "C" D3C_EXPORT const char *D3C_API d3c_actor_name(d3c_actor_t handle)
+{
+	return c_str(actor(handle)->name);
+}
+
+extern "C" D3C_EXPORT uint32_t D3C_API d3c_actor_id(d3c_actor_t handle)
+{
+	return actor(handle)->id;
+}
+
+extern "C" D3C_EXPORT uint32_t D3C_API d3c_actor_acd_id(d3c_actor_t handle)
+{
+	return actor(handle)->acd_id;
+}
+
+extern "C" D3C_EXPORT uint32_t D3C_API d3c_actor_world_id(d3c_actor_t handle)
+{
+	return actor(handle)->world_id;
+}
+
+extern "C" D3C_EXPORT const void *D3C_API d3c_actor_ptr(d3c_actor_t handle)
+{
+	return actor(handle)->ptr;
+}
+
+extern "C" D3C_EXPORT size_t D3C_API d3c_find_actors(d3c_snapshot_t snapshot, const char *fragment, d3c_actor_t *actors, size_t max)
+{
+	std::vector<uint32_t> ids;
+
+	// All names are interned before searching so the results include them
+	for(auto i = shared->data.actors->begin(); i != shared->data.actors->end(); ++i)
+		ids.push_back(names.intern(i().name ? i().name->c_str() : ""));
+
+	auto matches = names.find(fragment);
+
+	size_t count = 0;
+	size_t row = 0;
+
+	for(auto i = shared->data.actors->begin(); i != shared->data.actors->end(); ++i, ++row)
+	{
+		if(!std::binary_search(matches.begin(), matches.end(), ids[row]))
+			continue;
+
+		if(count < max)
+			actors[count] = (d3c_actor_t)*i;
+
+		count++;
+	}
+
+	return count;
+}
+
+extern "C" D3C_EXPORT d3c_acd_t D3C_API d3c_first_acd(d3c_snapshot_t snapshot)
+{
+	return (d3c_acd_t)shared->data.acds->first.get();
+}
+
+extern "C" D3C_EXPORT d3c_acd_t D3C_API d3c_next_acd(d3c_acd_t handle)
+{
+	return (d3c_acd_t)acd(handle)->next.get();
+}
+
+extern "C" D3C_EXPORT const char *D3C_API d3c_acd_name(d3c_acd_t handle)
+{
+	return c_str(acd(handle)->name);
+}
+
+extern "C" D3C_EXPORT uint32_t D3C_API d3c_acd_id(d3c_acd_t handle)
+{
+	return acd(handle)->id;
+}
+
+extern "C" D3C_EXPORT uint32_t D3C_API d3c_acd_owner_id(d3c_acd_t handle)
+{
+	return acd(handle)->owner_id;
+}
+
+extern "C" D3C_EXPORT const void *D3C_API d3c_acd_ptr(d3c_acd_t handle)
+{
+	return acd(handle)->ptr;
+}
+
+extern "C" D3C_EXPORT d3c_ui_node_t D3C_API d3c_ui_root(d3c_snapshot_t snapshot)
+{
+	return (d3c_ui_node_t)shared->data.ui_root.get();
+}
+
+extern "C" D3C_EXPORT size_t D3C_API d3c_ui_child_count(d3c_ui_node_t node)
+{
+	return ui_node(node)->children.size;
+}
+
+extern "C" D3C_EXPORT d3c_ui_node_t D3C_API d3c_ui_child(d3c_ui_node_t node, size_t index)
+{
+	auto &children = ui_node(node)->children;
+
+	if(index >= children.size)
+		return 0;
+
+	return (d3c_ui_node_t)children[index].get();
+}
+
+extern "C" D3C_EXPORT const char *D3C_API d3c_ui_name(d3c_ui_node_t node)
+{
+	return c_str(ui_node(node)->name);
+}
+
+extern "C" D3C_EXPORT const char *D3C_API d3c_ui_text(d3c_ui_node_t node)
+{
+	return c_str(ui_node(node)->text);
+}
+
+extern "C" D3C_EXPORT int D3C_API d3c_ui_visible(d3c_ui_node_t node)
+{
+	return ui_node(node)->visible;
+}
+
+extern "C" D3C_EXPORT uint64_t D3C_API d3c_ui_hash(d3c_ui_node_t node)
+{
+	return ui_node(node)->hash;
+}
+
+extern "C" D3C_EXPORT const float *D3C_API d3c_ui_rect(d3c_ui_node_t node)
+{
+	auto rect = ui_node(node)->rect.get();
+
+	// UIRect has no other members, so the coordinates are laid out as an array
+	return rect ? &rect->left : 0;
+}
+
+extern "C" D3C_EXPORT const void *D3C_API d3c_ui_ptr(d3c_ui_node_t node)
+{
+	return ui_node(node)->ptr;
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_register_ui_type(uint32_t vtable, d3c_ui_kind_t kind)
+{
+	return Shade::wrap([&] {
+		shared->ui_type.v_table = vtable;
+		shared->ui_type.kind = kind;
+
+		if(remote_call(Call::RegisterUIType) != Error::None)
+			error("Unable to register the UI type");
+	});
+}
@@ -0,0 +1,225 @@
+#include "world.hpp"
+#include "requests.hpp"
+#include "reader.hpp"
+#include "profile.hpp"
+#include <algorithm>
+#include <map>
+#include <fstream>
+#include <sstream>
+
+using namespace Shade;
+
+static const uint32_t cache_magic = 0x43574853; // "SHWC"
+static const uint32_t cache_version = 2;
+
+static std::map<uint32_t, World::Geometry> worlds;
+
+static uint64_t hash(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+/*
+	World ids are reused between games, so the geometry is identified by the loaded scenes and their positions instead.
+	The layout profile is included since it decides where the scenes and cells are read from.
+*/
+static uint64_t scenes_key(std::vector<External::Scene> &scenes)
+{
+	std::sort(scenes.begin(), scenes.end(), [](const External::Scene &a, const External::Scene &b) {
+		if(a.sno_id != b.sno_id)
+			return a.sno_id < b.sno_id;
+
+		return a.min_x != b.min_x ? a.min_x < b.min_x : a.min_y < b.min_y;
+	});
+
+	uint64_t result = hash(0xCBF29CE484222325ull, &cache_version, sizeof(cache_version));
+
+	for(auto scene = scenes.begin(); scene != scenes.end(); ++scene)
+		result = hash(result, &*scene, sizeof(External::Scene));
+
+	for(size_t i = 0; i < Layout::Count; ++i)
+		result = hash(result, &Layout::values[i].value, sizeof(Layout::values[i].value));
+
+	return result;
+}
+
+static std::string cache_name(uint64_t key)
+{
+	std::stringstream name;
+
+	name << "world-" << std::hex << key << ".cache";
+
+	return name.str();
+}
+
+static bool load(World::Geometry &geometry, uint32_t world_id, uint64_t key)
+{
+	std::ifstream file(cache_name(key).c_str(), std::ios::binary);
+
+	uint32_t magic, version, cells;
+
+	if(file.read((char *)&magic, sizeof(magic)).fail() || magic != cache_magic)
+		return false;
+
+	if(file.read((char *)&version, sizeof(version)).fail() || version != cache_version)
+		return false;
+
+	if(file.read((char *)&geometry.key, sizeof(geometry.key)).fail() || geometry.key != key)
+		return false;
+
+	geometry.world_id = world_id;
+
+	if(file.read((char *)&geometry.scenes, sizeof(geometry.scenes)).fail() || file.read((char *)geometry.bounds, sizeof(geometry.bounds)).fail())
+		return false;
+
+	if(file.read((char *)&cells, sizeof(cells)).fail())
+		return false;
+
+	geometry.cells.resize(cells);
+
+	return !cells || !file.read((char *)&geometry.cells[0], cells * sizeof(d3c_cell_t)).fail();
+}
+
+static void save(World::Geometry &geometry)
+{
+	std::string name = cache_name(geometry.key);
+	std::ofstream file(name.c_str(), std::ios::binary | std::ios::trunc);
+
+	uint32_t cells = geometry.cells.size();
+
+	file.write((const char *)&cache_magic, sizeof(cache_magic));
+	file.write((const char *)&cache_version, sizeof(cache_version));
+	file.write((const char *)&geometry.key, sizeof(geometry.key));
+	file.write((const char *)&geometry.scenes, sizeof(geometry.scenes));
+	file.write((const char *)geometry.bounds, sizeof(geometry.bounds));
+	file.write((const char *)&cells, sizeof(cells));
+
+	if(cells)
+		file.write((const char *)&geometry.cells[0], cells * sizeof(d3c_cell_t));
+
+	if(!file)
+		error("Unable to write " + name);
+}
+
+static void extract(World::Geometry &geometry, uint32_t world_id)
+{
+	if(Requests::acquire(Call::ExtractWorld, world_id) != Error::None)
+		error("Unable to extract the world geometry");
+
+	geometry.world_id = world_id;
+	geometry.scenes = 0;
+
+	for(auto i = shared->data.scenes->begin(); i != shared->data.scenes->end(); ++i)
+	{
+		auto &scene = i();
+
+		if(!geometry.scenes++)
+		{
+			geometry.bounds[0] = scene.min_x;
+			geometry.bounds[1] = scene.min_y;
+			geometry.bounds[2] = scene.max_x;
+			geometry.bounds[3] = scene.max_y;
+		}
+		else
+		{
+			if(scene.min_x < geometry.bounds[0])
+				geometry.bounds[0] = scene.min_x;
+
+			if(scene.min_y < geometry.bounds[1])
+				geometry.bounds[1] = scene.min_y;
+
+			if(scene.max_x > geometry.bounds[2])
+				geometry.bounds[2] = scene.max_x;
+
+			if(scene.max_y > geometry.bounds[3])
+				geometry.bounds[3] = scene.max_y;
+		}
+
+		// Remote::WorldCell has the same layout as d3c_cell_t
+		for(auto cell = scene.cells.begin(); cell != scene.cells.end(); ++cell)
+			geometry.cells.push_back(*(d3c_cell_t *)cell);
+	}
+
+	Requests::release();
+
+	if(!geometry.scenes)
+		memset(geometry.bounds, 0, sizeof(geometry.bounds));
+}
+
+const World::Geometry &World::get(uint32_t world_id)
+{
+	std::vector<External::Scene> scenes;
+
+	External::list_scenes(world_id, scenes);
+
+	// A world without scenes is still loading
+	if(scenes.empty())
+		error("The world has no loaded scenes");
+
+	uint64_t key = scenes_key(scenes);
+
+	// Scenes are loaded as the world is explored, so the geometry is only reused while the same scenes are loaded
+	auto result = worlds.find(world_id);
+
+	if(result != worlds.end() && result->second.key == key)
+		return result->second;
+
+	World::Geometry geometry;
+
+	bool loaded = load(geometry, world_id, key);
+
+	if(!loaded)
+	{
+		geometry.cells.clear();
+
+		extract(geometry, world_id);
+
+		if(!geometry.scenes)
+			error("The world has no loaded scenes");
+
+		// Scenes changed between listing and extraction, so the result is neither reused nor saved
+		geometry.key = geometry.scenes == scenes.size() ? key : 0;
+	}
+
+	// The geometry is only stored once it's complete, so a failed extraction isn't served as a cache hit later
+	auto &entry = worlds[world_id];
+
+	entry = geometry;
+
+	if(!loaded && entry.key)
+		save(entry);
+
+	return entry;
+}
+
+extern "C" D3C_EXPORT d3c_error_t D3C_API d3c_world_geometry(uint32_t world_id, d3c_world_t *world)
+{
+	return Shade::wrap([&] {
+		*world = (d3c_world_t)&World::get(world_id);
+	});
+}
+
+extern "C" D3C_EXPORT const float *D3C_API d3c_world_bounds(d3c_world_t world)
+{
+	return ((World::Geometry *)world)->bounds;
+}
+
+extern "C" D3C_EXPORT size_t D3C_API d3c_world_cell_count(d3c_world_t world)
+{
+	return ((World::Geometry *)world)->cells.size();
+}
+
+extern "C" D3C_EXPORT const d3c_cell_t *D3C_API d3c_world_cells(d3c_world_t world)
+{
+	auto &cells = ((World::Geometry *)world)->cells;
+
+	return cells.empty() ? 0 : &cells[0];
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "shade.hpp"
+
+namespace Shade
+{
+	/*
+		Navigation data for worlds. Scenes are loaded as the world is explored, so the geometry is kept for
+		each set of loaded scenes, in memory and in world-<key>.cache, and extracted again when the set changes.
+		The key hashes the scene SNO ids, their positions and the layout profile, since world ids are reused.
+		Only walkable cells are kept, in world coordinates.
+	*/
+	namespace World
+	{
+		struct Geometry
+		{
+			uint32_t world_id;
+			uint64_t key; // Key of the loaded scenes or 0 if they changed during extraction
+			size_t scenes;
+			float bounds[4]; // Left, top, right and bottom of all scenes
+			std::vector<d3c_cell_t> cells;
+		};
+
+		/*
+			Returns the geometry of the loaded scenes of the world, extracting it with a remote call if it isn't cached.
+			The result is replaced by the next call for the same world if its scenes changed.
+		*/
+		const Geometry &get(uint32_t world_id);
+	};
+};